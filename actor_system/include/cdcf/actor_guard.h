@@ -5,7 +5,14 @@
 #ifndef ACTOR_SYSTEM_INCLUDE_CDCF_ACTOR_GUARD_H_
 #define ACTOR_SYSTEM_INCLUDE_CDCF_ACTOR_GUARD_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 #include <caf/all.hpp>
 #include <caf/io/all.hpp>
@@ -13,32 +20,94 @@
 #include "cdcf/logger.h"
 
 namespace cdcf {
+/* Actor kept by a guard, shared with the guard's async requests so they can
+ * outlive it. Restarts are done once however many requests see the actor
+ * fail, requests coming meanwhile wait for the restart to end. */
+class GuardedActor : public std::enable_shared_from_this<GuardedActor> {
+ public:
+  using Ready = std::function<void(const caf::actor&)>;
+
+  GuardedActor(caf::actor actor,
+               std::function<caf::actor(std::atomic<bool>&)> restart)
+      : actor_(std::move(actor)), restart_(std::move(restart)) {}
+
+  bool Active() const { return active_; }
+
+  /* actor once it's not restarting, null if it's inactive. */
+  caf::actor Await();
+
+  /* call `ready` with the actor once it's not restarting, with null if it's
+   * inactive. */
+  void WhenReady(Ready ready);
+
+  /* restart `failed` on a detached actor unless it's restarted already, then
+   * call `ready` as WhenReady. */
+  void Restart(caf::actor_system& system, const caf::actor& failed,
+               Ready ready);
+
+  /* restart `failed` on calling thread unless it's restarted already, return
+   * as Await. */
+  caf::actor RestartNow(const caf::actor& failed);
+
+ private:
+  /* restarting_ must be set by caller. */
+  void DoRestart();
+
+  std::mutex mutex_;
+  std::condition_variable restarted_;
+  caf::actor actor_;
+  std::function<caf::actor(std::atomic<bool>&)> restart_;
+  std::atomic<bool> active_ = true;
+  bool restarting_ = false;
+  std::vector<Ready> waiting_;
+};
+
 class ActorGuard {
  public:
   ActorGuard(caf::actor& keepActor,
              std::function<caf::actor(std::atomic<bool>&)> restart,
              caf::actor_system& system,
              std::chrono::seconds timeout_in_seconds = std::chrono::seconds(30))
-      : keep_actor_(keepActor),
-        restart_fun_(std::move(restart)),
+      : guarded_(std::make_shared<GuardedActor>(keepActor, std::move(restart))),
         sender_actor_(system),
+        system_(system),
         timeout_in_seconds_(timeout_in_seconds) {}
 
   template <class... send_type, class return_function_type>
   bool SendAndReceive(return_function_type return_function,
                       std::function<void(caf::error)> error_deal_function,
                       const send_type&... messages) {
-    if (active_) {
+    if (guarded_->Active()) {
       caf::message send_message = caf::make_message(messages...);
       std::lock_guard<std::mutex> lock_gard(keeper_locker);
-      sender_actor_->request(keep_actor_, timeout_in_seconds_, messages...)
+      auto keep_actor = guarded_->Await();
+      sender_actor_->request(keep_actor, timeout_in_seconds_, messages...)
           .receive(return_function, [&](caf::error err) {
             HandleSendFailed(send_message, return_function, error_deal_function,
-                             err);
+                             err, keep_actor);
           });
     }
 
-    return active_;
+    return guarded_->Active();
+  }
+
+  /* Same as SendAndReceive without blocking the caller, so any number of
+   * requests can be in flight to the guarded actor. A request failing with a
+   * system error is replayed once on the restarted actor, requests sent
+   * during a restart are held until it ends. Handlers run on the actor
+   * system's threads. */
+  template <class... send_type, class return_function_type>
+  void AsyncSendAndReceive(return_function_type return_function,
+                           std::function<void(caf::error)> error_deal_function,
+                           const send_type&... messages) {
+    auto message = caf::make_message(messages...);
+    auto guarded = guarded_;
+    auto timeout = timeout_in_seconds_;
+    auto system = &system_;
+    guarded_->WhenReady([=](const caf::actor& actor) {
+      AsyncRequest(system, guarded, timeout, message, return_function,
+                   error_deal_function, actor, false);
+    });
   }
 
  private:
@@ -47,42 +116,39 @@ class ActorGuard {
       return_function_type return_function,
       std::function<void(caf::error)> error_deal_function,
       const send_type&... messages) {
-    if (active_) {
+    if (guarded_->Active()) {
       caf::message send_message = caf::make_message(messages...);
-      sender_actor_->request(keep_actor_, timeout_in_seconds_, messages...)
+      auto keep_actor = guarded_->Await();
+      sender_actor_->request(keep_actor, timeout_in_seconds_, messages...)
           .receive(return_function, [&](caf::error err) {
             HandleSendFailed(send_message, return_function, error_deal_function,
-                             err);
+                             err, keep_actor);
           });
     }
 
-    return active_;
+    return guarded_->Active();
   }
 
   template <class return_function_type>
   void HandleSendFailed(const caf::message& message,
                         return_function_type return_function,
                         std::function<void(caf::error)> error_deal_function,
-                        const caf::error& err) {
+                        const caf::error& err, const caf::actor& failed) {
     if ("system" != caf::to_string(err.category())) {
       // not system error, mean actor not down, this is a business error.
       error_deal_function(err);
       return;
     }
-    {
-      CDCF_LOGGER_ERROR(
-          "send msg failed, try restart dest actor. message:{}, error str:{}, "
-          "old actor:{}",
-          caf::to_string(message), caf::to_string(err),
-          caf::to_string(keep_actor_.address()));
-      keep_actor_ = restart_fun_(active_);
-    }
+    CDCF_LOGGER_ERROR(
+        "send msg failed, try restart dest actor. message:{}, error str:{}, "
+        "old actor:{}",
+        caf::to_string(message), caf::to_string(err),
+        caf::to_string(failed.address()));
+    auto keep_actor = guarded_->RestartNow(failed);
 
-    if (active_) {
+    if (guarded_->Active()) {
       CDCF_LOGGER_INFO("restart actor success. new actor:{}",
-                       caf::to_string(keep_actor_.address()));
-      // wait for start actor ready
-      std::this_thread::sleep_for(std::chrono::seconds(2));
+                       caf::to_string(keep_actor.address()));
       (void)SendAndReceiveInternal(return_function, error_deal_function,
                                    message);
     } else {
@@ -92,11 +158,52 @@ class ActorGuard {
     }
   }
 
+  template <class return_function_type>
+  static void AsyncRequest(
+      caf::actor_system* system, const std::shared_ptr<GuardedActor>& guarded,
+      std::chrono::seconds timeout, const caf::message& message,
+      return_function_type return_function,
+      std::function<void(caf::error)> error_deal_function,
+      const caf::actor& actor, bool replayed) {
+    if (!actor) {
+      CDCF_LOGGER_ERROR("guarded actor inactive. message:{} will not deliver.",
+                        caf::to_string(message));
+      error_deal_function(caf::make_error(caf::sec::request_receiver_down));
+      return;
+    }
+    system->spawn([=](caf::event_based_actor* self) {
+      self->request(actor, timeout, message)
+          .then(return_function, [=](caf::error& err) {
+            if ("system" != caf::to_string(err.category()) || replayed) {
+              error_deal_function(err);
+              return;
+            }
+            CDCF_LOGGER_ERROR(
+                "send msg failed, try restart dest actor. message:{}, error "
+                "str:{}, old actor:{}",
+                caf::to_string(message), caf::to_string(err),
+                caf::to_string(actor.address()));
+            guarded->Restart(
+                *system, actor, [=](const caf::actor& restarted) {
+                  if (!restarted) {
+                    CDCF_LOGGER_ERROR(
+                        "restart actor failed. message:{} will not deliver.",
+                        caf::to_string(message));
+                    error_deal_function(err);
+                    return;
+                  }
+                  AsyncRequest(system, guarded, timeout, message,
+                               return_function, error_deal_function, restarted,
+                               true);
+                });
+          });
+    });
+  }
+
   std::mutex keeper_locker;
-  caf::actor keep_actor_;
+  std::shared_ptr<GuardedActor> guarded_;
   caf::scoped_actor sender_actor_;
-  std::function<caf::actor(std::atomic<bool>&)> restart_fun_;
-  std::atomic<bool> active_ = true;
+  caf::actor_system& system_;
   std::chrono::seconds timeout_in_seconds_;
 };
 }  // namespace cdcf
@@ -20,6 +20,14 @@ class ActorMonitor : public caf::event_based_actor {
                    downMsgFun);
   caf::behavior make_behavior() override;
 
+ protected:
+  /* report down of a monitored actor with its description. */
+  virtual void OnDown(const caf::down_msg& down_msg);
+  void Describe(const caf::actor_addr& actor_addr,
+                const std::string& description);
+  /* drop description of an actor no longer monitored. */
+  void Forget(const caf::actor_addr& actor_addr);
+
  private:
   std::mutex actor_map_lock;
   std::function<void(const caf::down_msg& down_msg,
@@ -4,7 +4,15 @@
 
 #ifndef ACTOR_SYSTEM_INCLUDE_CDCF_ACTOR_UNION_H_
 #define ACTOR_SYSTEM_INCLUDE_CDCF_ACTOR_UNION_H_
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <caf/all.hpp>
 #include <caf/io/all.hpp>
@@ -17,6 +25,70 @@ enum class actor_union_error : uint8_t { all_actor_out_of_work = 1 };
 caf::error make_error(actor_union_error x);
 std::string to_string(actor_union_error x);
 
+/* Circuit breakers of union members. A member failing with a system error
+ * is skipped for a backoff doubling with every failure in a row, from
+ * kBaseBackoff up to kMaxBackoff, a member gone down is skipped until it's
+ * removed. Thread safe. */
+class MemberHealth {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::chrono::seconds kBaseBackoff{1};
+  static constexpr std::chrono::seconds kMaxBackoff{60};
+
+  /* `route` is what the pool routes to in place of `member`. */
+  void Add(const caf::actor& member, const caf::actor& route);
+  void Remove(const caf::actor& member);
+  void Down(const caf::actor_addr& member);
+  void Fail(const caf::actor_addr& member);
+
+  /* cheap check for the common case, where nothing needs to be skipped. */
+  bool AllHealthy() const { return unhealthy_ == 0; }
+
+  /* routes of members whose circuit is closed, or of all alive ones if none
+   * is. */
+  std::vector<caf::actor> Filter(const std::vector<caf::actor>& routes);
+
+  /* a member with closed circuit not in `tried`, null if there's none. */
+  caf::actor Pick(const std::vector<caf::actor_addr>& tried);
+
+ private:
+  struct Circuit {
+    caf::actor member;
+    caf::actor route;
+    bool down{false};
+    uint32_t failures{0};
+    Clock::time_point open_until;
+  };
+
+  static Clock::duration Backoff(uint32_t failures);
+  /* forget failures of members healthy for a whole backoff since. */
+  void Refresh(Clock::time_point now);
+  std::vector<Circuit>::iterator Find(const caf::actor_addr& member);
+  std::vector<Circuit>::iterator FindRoute(const caf::actor_addr& route);
+
+  std::mutex mutex_;
+  std::vector<Circuit> circuits_;
+  size_t cursor_{0};
+  std::atomic<size_t> unhealthy_{0};
+};
+
+/* Member each request was routed to by policy, keyed by requester and request
+ * id, so a failure is charged to the member even if the error doesn't come
+ * from it. Thread safe. */
+class RouteLog {
+ public:
+  void Record(const caf::strong_actor_ptr& sender, caf::message_id id,
+              const caf::actor_addr& member);
+  /* member `id` of `sender` was routed to, null if unknown, and forget it. */
+  caf::actor_addr Take(const caf::actor_addr& sender, caf::message_id id);
+  /* forget requests of `sender`, once it's gone. */
+  void Forget(const caf::actor_addr& sender);
+
+ private:
+  std::mutex mutex_;
+  std::map<std::pair<caf::actor_addr, uint64_t>, caf::actor_addr> members_;
+};
+
 class ActorUnion {
  public:
   ActorUnion(
@@ -30,40 +102,143 @@ class ActorUnion {
   void SendAndReceive(return_function_type return_function,
                       std::function<void(caf::error)> err_deal,
                       const send_type&... messages) {
-    SendAndReceiveWithTryTime(return_function, err_deal, 0, messages...);
+    SendAndReceiveWithTryTime(return_function, err_deal, 0, {},
+                              caf::make_message(messages...));
+  }
+
+  /* Same as SendAndReceive without blocking the caller, so any number of
+   * requests can be in flight through the union. Each request is awaited and
+   * retried by a short-lived actor, handlers run on the actor system's
+   * threads. */
+  template <class... send_type, class return_function_type>
+  void AsyncSendAndReceive(return_function_type return_function,
+                           std::function<void(caf::error)> err_deal,
+                           const send_type&... messages) {
+    auto message = caf::make_message(messages...);
+    Route route{pool_actor_, health_, log_, timeout_in_seconds_,
+                actor_count_};
+    system_.spawn([=](caf::event_based_actor* self) {
+      self->attach_functor(
+          [log = route.log, sender = self->address()](const caf::error&) {
+            log->Forget(sender);
+          });
+      // actor quits itself once no response is awaited
+      AsyncRequest(self, route, message, return_function, err_deal, 0, {});
+    });
   }
 
  private:
+  /* what an async request needs to retry after the union is gone. */
+  struct Route {
+    caf::actor pool;
+    std::shared_ptr<MemberHealth> health;
+    std::shared_ptr<RouteLog> log;
+    std::chrono::seconds timeout;
+    uint16_t max_try_time;
+  };
+
+  caf::actor_system& system_;
+  std::shared_ptr<MemberHealth> health_ = std::make_shared<MemberHealth>();
+  std::shared_ptr<RouteLog> log_ = std::make_shared<RouteLog>();
+  // member -- route standing in for it in the pool
+  std::map<caf::actor, caf::actor> routes_;
   caf::actor pool_actor_;
   caf::scoped_execution_unit* context_;
   caf::scoped_actor sender_actor_;
   uint16_t actor_count_ = 0;
   std::chrono::seconds timeout_in_seconds_;
 
-  template <class... send_type, class return_function_type>
+  /* first try is routed by policy, retries go to members not tried yet with
+   * closed circuit. Member a first try was routed to is taken from the route
+   * log, so its failure is charged to it even on a timeout. */
+  template <class return_function_type>
   void SendAndReceiveWithTryTime(
       return_function_type return_function,
       std::function<void(caf::error)> handle_error_function,
-      uint16_t has_try_time, const send_type&... messages) {
-    caf::message send_message = caf::make_message(messages...);
-    sender_actor_->request(pool_actor_, timeout_in_seconds_, messages...)
-        .receive(return_function, [=](caf::error err) {
-          HandleSendFailed(send_message, return_function, handle_error_function,
-                           err, has_try_time);
-        });
+      uint16_t has_try_time, std::vector<caf::actor_addr> tried,
+      const caf::message& message) {
+    const auto routed = has_try_time == 0;
+    auto target = routed ? pool_actor_ : health_->Pick(tried);
+    if (!target) {
+      CDCF_LOGGER_ERROR("no actor left to try, return error. try_time:{}",
+                        has_try_time);
+      handle_error_function(
+          make_error(actor_union_error::all_actor_out_of_work));
+      return;
+    }
+    auto handle = sender_actor_->request(target, timeout_in_seconds_, message);
+    const auto id = handle.id();
+    const auto sender = sender_actor_->address();
+    handle.receive(return_function, [=](caf::error err) {
+      auto failed = routed ? log_->Take(sender, id) : target.address();
+      HandleSendFailed(message, return_function, handle_error_function, err,
+                       has_try_time, tried, failed);
+    });
+    if (routed) {
+      log_->Take(sender, id);
+    }
+  }
+
+  template <class return_function_type>
+  static void AsyncRequest(
+      caf::event_based_actor* self, const Route& route,
+      const caf::message& message, return_function_type return_function,
+      std::function<void(caf::error)> handle_error_function,
+      uint16_t has_try_time, std::vector<caf::actor_addr> tried) {
+    const auto routed = has_try_time == 0;
+    auto target = routed ? route.pool : route.health->Pick(tried);
+    if (!target) {
+      CDCF_LOGGER_ERROR("no actor left to try, return error. try_time:{}",
+                        has_try_time);
+      handle_error_function(
+          make_error(actor_union_error::all_actor_out_of_work));
+      return;
+    }
+    auto handle = self->request(target, route.timeout, message);
+    const auto id = handle.id();
+    handle.then(return_function, [=](caf::error& err) mutable {
+      auto failed = routed ? route.log->Take(self->address(), id)
+                           : target.address();
+      if ("system" != caf::to_string(err.category())) {
+        handle_error_function(err);
+        return;
+      }
+      if (failed) {
+        route.health->Fail(failed);
+        tried.push_back(failed);
+      }
+      if (has_try_time + 1 <= route.max_try_time) {
+        CDCF_LOGGER_ERROR(
+            "send msg failed, try send to another actor. try_time:{}",
+            has_try_time + 1);
+        AsyncRequest(self, route, message, return_function,
+                     handle_error_function, has_try_time + 1, tried);
+      } else {
+        CDCF_LOGGER_ERROR("send msg failed, return error. try_time:{}",
+                          has_try_time + 1);
+        handle_error_function(
+            make_error(actor_union_error::all_actor_out_of_work));
+      }
+    });
   }
 
   template <class return_function_type>
   void HandleSendFailed(const caf::message& msg,
                         return_function_type return_function,
                         std::function<void(caf::error)> handle_error_function,
-                        caf::error err, uint16_t has_try_time) {
+                        caf::error err, uint16_t has_try_time,
+                        std::vector<caf::actor_addr> tried,
+                        const caf::actor_addr& failed) {
     if ("system" != caf::to_string(err.category())) {
       // not system error, mean actor not down, this is a business error.
       handle_error_function(err);
       return;
     }
 
+    if (failed) {
+      health_->Fail(failed);
+      tried.push_back(failed);
+    }
     has_try_time++;
 
     if (has_try_time <= actor_count_) {
@@ -71,7 +246,7 @@ class ActorUnion {
           "send msg failed, try send to another actor. try_time:{}",
           has_try_time);
       SendAndReceiveWithTryTime(return_function, handle_error_function,
-                                has_try_time, msg);
+                                has_try_time, tried, msg);
     } else {
       CDCF_LOGGER_ERROR("send msg failed, return error. try_time:{}",
                         has_try_time);
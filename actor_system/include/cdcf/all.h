@@ -14,9 +14,13 @@
 #include "cdcf/actor_status_service_grpc_impl.h"
 #include "cdcf/actor_union.h"
 #include "cdcf/cluster/cluster.h"
+#include "cdcf/deadline_actor.h"
 #include "cdcf/load_balancer/load_balancer.h"
 #include "cdcf/load_balancer/policy.h"
 #include "cdcf/message_priority_actor.h"
+#include "cdcf/priority_lane_actor.h"
 #include "cdcf/router_pool/router_pool.h"
+#include "cdcf/scheduling_actor.h"
+#include "cdcf/supervisor.h"
 
 #endif  // ACTOR_SYSTEM_INCLUDE_CDCF_ALL_H_
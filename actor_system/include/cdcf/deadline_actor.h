@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#ifndef ACTOR_SYSTEM_INCLUDE_CDCF_DEADLINE_ACTOR_H_
+#define ACTOR_SYSTEM_INCLUDE_CDCF_DEADLINE_ACTOR_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <caf/all.hpp>
+
+#include "cdcf/scheduling_actor.h"
+
+namespace cdcf {
+using deadline_atom = caf::atom_constant<caf::atom("deadline")>;
+
+enum class deadline_actor_error : uint8_t { deadline_missed = 1 };
+
+caf::error make_error(deadline_actor_error x);
+std::string to_string(deadline_actor_error x);
+
+/* Actor handling its mails earliest deadline first.
+ *
+ * Mail is sent with a deadline as (deadline_atom, caf::timestamp, args...), or
+ * with a time budget counted from its arrival as (deadline_atom, caf::timespan,
+ * args...). Tags are stripped before the mail is handled, mail without a
+ * deadline is handled after all mails with one, in arrival order.
+ *
+ * Deadlines are checked when mail is passed to the mailbox: mail found past
+ * its deadline is not handled, a request is answered with deadline_missed,
+ * other mail is dropped. Up to `batch` mails already in the mailbox are
+ * handled even if their deadline passes while they wait there. */
+class DeadlineActor : public SchedulingActor {
+ public:
+  explicit DeadlineActor(caf::actor_config& cfg, size_t batch = 1);
+
+  /* mails dropped or failed for missing their deadline so far. */
+  size_t Missed() const { return missed_; }
+
+ protected:
+  void Push(caf::mailbox_element_ptr ptr, caf::execution_unit* eu) override;
+  caf::mailbox_element_ptr Pop(caf::execution_unit* eu) override;
+
+ private:
+  struct Entry {
+    caf::timestamp deadline;
+    /* keeps arrival order among equal deadlines. */
+    uint64_t sequence;
+    caf::mailbox_element_ptr mail;
+  };
+
+  static bool Later(const Entry& lhs, const Entry& rhs);
+  /* count the mail missed, a request is answered once the lock is released. */
+  void Miss(caf::mailbox_element_ptr ptr);
+
+  /* min heap by deadline. */
+  std::vector<Entry> heap_;
+  uint64_t sequence_{0};
+  std::atomic<size_t> missed_{0};
+};
+}  // namespace cdcf
+
+#endif  // ACTOR_SYSTEM_INCLUDE_CDCF_DEADLINE_ACTOR_H_
@@ -5,9 +5,14 @@
 #define ACTOR_SYSTEM_INCLUDE_CDCF_LOAD_BALANCER_LOAD_BALANCER_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <caf/all.hpp>
@@ -15,14 +20,93 @@
 #include "./policy.h"
 
 namespace cdcf::load_balancer {
+enum class load_balancer_error : uint8_t { overloaded = 1 };
+
+caf::error make_error(load_balancer_error x);
+std::string to_string(load_balancer_error x);
+
 using Lock = caf::upgrade_lock<caf::detail::shared_spinlock>;
 
+using batch_atom = caf::atom_constant<caf::atom("batch")>;
+using stats_atom = caf::atom_constant<caf::atom("stats")>;
+
+/* Snapshot of a Router, reply of (sys_atom, get_atom, stats_atom). Ticket
+ * counters count a batch once, rates are their deltas over time. */
+struct Stats {
+  uint64_t relayed{0};
+  uint64_t replied{0};
+  uint64_t expired{0};
+  uint64_t shed{0};
+  /* tickets waiting for replies. */
+  size_t pending{0};
+  /* mails held by the policy. */
+  size_t held{0};
+  /* indexed as workers, latency in microseconds. */
+  std::vector<caf::actor> workers;
+  std::vector<size_t> loads;
+  std::vector<uint64_t> latencies;
+};
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector &f, Stats &x) {
+  return f(caf::meta::type_name("load_balancer_stats"), x.relayed, x.replied,
+           x.expired, x.shed, x.pending, x.held, x.workers, x.loads,
+           x.latencies);
+}
+
+/* Optional behaviours of Router, all off by default. */
+struct Options {
+  /* answer a request with `caf::sec::request_timeout` and release the load
+   * of its worker if no reply arrives in time, zero waits forever. */
+  std::chrono::milliseconds ticket_timeout{0};
+  /* relay up to `batch_size` requests to the same worker as one message,
+   * waiting no longer than `batch_delay` for it to fill up. Workers have to
+   * accept batches, see AcceptBatch. Less than 2 disables batching. */
+  size_t batch_size{0};
+  std::chrono::microseconds batch_delay{100};
+  /* relay a request once more to another worker if it's not answered within
+   * this percentile of round trips seen so far, e.g. 0.95, the first reply
+   * wins. Hedges are capped at `hedge_budget` of requests. Zero disables
+   * hedging, batched requests are never hedged. */
+  double hedge_percentile{0};
+  double hedge_budget{0.05};
+};
+
+/* Behavior of a worker taking batches relayed by Router besides single
+ * messages. Requests in a batch are handled by `handlers` one by one and must
+ * be answered synchronously, their replies go back as one message. */
+template <class... Handlers>
+caf::behavior AcceptBatch(Handlers... handlers) {
+  caf::behavior single{handlers...};
+  return {[single](batch_atom, caf::message &batch) mutable {
+            caf::message_builder replies;
+            for (size_t i = 0; i < batch.size(); ++i) {
+              auto request = batch.get_as<caf::message>(i);
+              auto reply = single(request);
+              replies.append(reply ? std::move(*reply) : caf::message{});
+            }
+            return replies.move_to_message();
+          },
+          std::move(handlers)...};
+}
+
+class Batcher;
+class Hedger;
 class Proxy;
 
+/* Business messages are dispatched holding `lock_` in shared mode only, load
+ * counters are atomic and tickets are sharded by the scheduler's thread count,
+ * membership changes are the only writers taking the lock exclusively.
+ *
+ * Routers can be stacked, a Router joining a parent with
+ * (sys_atom, join_atom, parent) is added to the parent as a worker with the
+ * total capacity of its own workers, and reports it again whenever its
+ * workers change. */
 class Router : public caf::monitorable_actor {
  public:
   static caf::actor Make(caf::execution_unit *host,
-                         load_balancer::Policy &&policy);
+                         load_balancer::Policy &&policy,
+                         const Options &options = {});
 
  public:
   explicit Router(caf::actor_config &config);
@@ -36,8 +120,6 @@ class Router : public caf::monitorable_actor {
   void on_cleanup(const caf::error &reason) override;
 
  private:
-  std::vector<Metrics> GetMetrics() const;
-
   bool Filter(Lock &guard, caf::mailbox_element_ptr &what,
               caf::execution_unit *eu);
 
@@ -45,30 +127,89 @@ class Router : public caf::monitorable_actor {
 
   void DeleteWorker(Lock &guard, const caf::actor &worker);
 
-  void AddWorker(Lock &guard, const caf::actor &worker);
+  void AddWorker(Lock &guard, const caf::actor &worker, size_t capacity);
+
+  void UpdateCapacity(Lock &guard, size_t index, size_t capacity);
+
+  void Join(Lock &guard, const caf::actor &parent);
+
+  void Leave(Lock &guard, const caf::actor &parent);
+
+  /* messages telling parents the capacity of this router, built holding the
+   * lock and sent by Send after releasing it, as a parent may be reporting to
+   * this router at the same time. */
+  using Reports = std::vector<std::pair<caf::actor, caf::message>>;
+
+  Reports Report();
+
+  void Report(const caf::actor_addr &parent, Reports &reports);
+
+  static void Send(const Reports &reports);
 
   void Down(Lock &guard, caf::execution_unit *eu, const caf::down_msg &dm);
 
   void Exit(Lock &guard, caf::execution_unit *eu, const caf::exit_msg &message);
 
+  void Reply(caf::mailbox_element_ptr &what, caf::execution_unit *host);
+
+  Stats Snapshot() const;
+
+  /* select a worker for `what` or a held mail and relay it. */
+  void Dispatch(caf::mailbox_element_ptr what, caf::execution_unit *host);
+
+  /* answer a mail the policy can't take with an overloaded error. */
+  void Shed(caf::mailbox_element_ptr &what, caf::execution_unit *host);
+
+  /* answer expired tickets with a timeout, keep sweeping while any ticket is
+   * pending. */
+  void Sweep(caf::execution_unit *host);
+
+  void ScheduleSweep();
+
+  void Batch(const caf::actor &worker, uint64_t generation,
+             caf::mailbox_element_ptr &what, caf::execution_unit *host);
+
+  /* relay what's buffered for `worker` of `generation`, fired `batch_delay_`
+   * after a batch starts. */
+  void Flush(const caf::actor &worker, uint64_t generation,
+             caf::execution_unit *host);
+
+  void ScheduleHedge(const caf::message_id &request_id);
+
+  /* relay a request not answered in time to the least loaded other worker. */
+  void Hedge(const caf::message_id &response_id, caf::execution_unit *host);
+
+  void IncreaseLoad(size_t index);
+
+  void DecreaseLoad(size_t index);
+
+  /* rebuild index_ and notify policy, must hold the lock exclusively. */
+  void Reindex();
+
+  /* index of `worker` if it's still of `generation`, workers_.size() if it's
+   * removed since, even if it's added again. */
+  size_t IndexOf(const caf::actor &worker, uint64_t generation) const;
+
   caf::detail::shared_spinlock lock_;
   caf::exit_reason planned_reason_;
   std::vector<caf::actor> workers_;
-  std::unordered_map<caf::actor, Metrics> metrics_;
+  /* metrics_[i] and generations_[i] belong to workers_[i], index_ maps
+   * worker back to i. */
+  std::vector<Metrics> metrics_;
+  std::vector<uint64_t> generations_;
+  uint64_t next_generation_{0};
+  std::unordered_map<caf::actor, size_t> index_;
+  /* routers this one is a worker of, weak so they don't keep each other
+   * alive. */
+  std::vector<caf::actor_addr> parents_;
   std::unique_ptr<Proxy> proxy_;
+  std::unique_ptr<Batcher> batcher_;
+  std::chrono::microseconds batch_delay_{0};
+  std::unique_ptr<Hedger> hedger_;
   Policy policy_;
+  std::atomic<bool> sweeping_{false};
+  std::atomic<uint64_t> shed_{0};
 };
 
-inline std::vector<Metrics> Router::GetMetrics() const {
-  std::vector<Metrics> result(workers_.size());
-  std::transform(workers_.begin(), workers_.end(), result.begin(),
-                 [&](auto &worker) {
-                   auto it = metrics_.find(worker);
-                   assert(it != metrics_.end());
-                   return it->second;
-                 });
-  return result;
-}
-
 }  // namespace cdcf::load_balancer
 #endif  // ACTOR_SYSTEM_INCLUDE_CDCF_LOAD_BALANCER_LOAD_BALANCER_H_
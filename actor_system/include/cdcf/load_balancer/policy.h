@@ -3,25 +3,152 @@
  */
 #ifndef ACTOR_SYSTEM_INCLUDE_CDCF_LOAD_BALANCER_POLICY_H_
 #define ACTOR_SYSTEM_INCLUDE_CDCF_LOAD_BALANCER_POLICY_H_
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <caf/all.hpp>
 
 namespace cdcf::load_balancer {
+/* Router updates metrics from every scheduler thread without holding an
+ * exclusive lock, copying takes a snapshot of the counters. */
 struct Metrics {
-  size_t load;
+  Metrics() = default;
+  Metrics(const Metrics &other) { *this = other; }
+  Metrics &operator=(const Metrics &other) {
+    load = other.load.load();
+    capacity = other.capacity;
+    latency = other.latency.load();
+    throughput = other.throughput.load();
+    window_start = other.window_start.load();
+    window_replies = other.window_replies.load();
+    return *this;
+  }
+
+  std::atomic<size_t> load{0};
+  /* relative capacity given when adding the worker, only changes while
+   * Router holds the lock exclusively. */
+  size_t capacity{1};
+  /* EWMA of request round trip in microseconds, 0 until the first reply. */
+  std::atomic<uint64_t> latency{0};
+  /* EWMA of replies per second, sampled once per window. */
+  std::atomic<uint64_t> throughput{0};
+  /* bookkeeping of the current throughput window, steady clock in
+   * microseconds and replies received since then. */
+  std::atomic<uint64_t> window_start{0};
+  std::atomic<uint64_t> window_replies{0};
+};
+
+/* Counters of mails a policy holds back, or sheds when it can't hold more. */
+struct HoldStats {
+  size_t held{0};
+  size_t peak{0};
+  uint64_t rejected{0};
+  uint64_t dropped{0};
 };
 
-using Policy = std::function<std::pair<caf::actor, caf::mailbox_element_ptr>(
+/* Optional hooks for a policy keeping its own index over workers. Router
+ * calls Reset with exclusive access whenever workers change, Increase and
+ * Decrease right after it changes `Metrics::load` of the worker at `index`. */
+class MetricsObserver {
+ public:
+  virtual ~MetricsObserver() = default;
+  virtual void Reset(const std::vector<caf::actor> &actors,
+                     const std::vector<Metrics> &metrics) = 0;
+  virtual void Increase(size_t index) = 0;
+  virtual void Decrease(size_t index) = 0;
+  virtual HoldStats Hold() const { return {}; }
+};
+
+/* Select may be invoked concurrently from several threads, Router only
+ * guarantees `actors` and `metrics` are not resized during the call. A mail
+ * returned without an actor is shed, Router answers its requester with
+ * `load_balancer_error::overloaded`. */
+using Select = std::function<std::pair<caf::actor, caf::mailbox_element_ptr>(
     const std::vector<caf::actor> &actors, const std::vector<Metrics> &metrics,
     caf::mailbox_element_ptr &mail)>;
 
+class Policy {
+ public:
+  Policy() = default;
+
+  template <class F, class = std::enable_if_t<
+                         !std::is_same_v<std::decay_t<F>, Policy> &&
+                         std::is_constructible_v<Select, F>>>
+  Policy(F &&select)  // NOLINT(runtime/explicit)
+      : select_(std::forward<F>(select)) {}
+
+  Policy(Select select, std::shared_ptr<MetricsObserver> observer)
+      : select_(std::move(select)), observer_(std::move(observer)) {}
+
+  std::pair<caf::actor, caf::mailbox_element_ptr> operator()(
+      const std::vector<caf::actor> &actors,
+      const std::vector<Metrics> &metrics,
+      caf::mailbox_element_ptr &mail) const {
+    return select_(actors, metrics, mail);
+  }
+
+  MetricsObserver *Observer() const { return observer_.get(); }
+
+ private:
+  Select select_;
+  std::shared_ptr<MetricsObserver> observer_;
+};
+
 namespace policy {
 
 static constexpr const size_t kDefaultLoadThreshold{10};
 
-Policy MinLoad(size_t load_threshold_to_hold = kDefaultLoadThreshold);
+static constexpr const size_t kUnboundedHold{
+    std::numeric_limits<size_t>::max()};
+
+/* What MinLoad does with a new mail while its hold queue is full. */
+enum class Overflow {
+  /* shed the new mail. */
+  kReject,
+  /* shed the oldest held mail and hold the new one. */
+  kDropOldest,
+  /* shed every new mail until the queue drains to half of its capacity, so
+   * upstream sees a steady overloaded signal to slow down on. */
+  kBackpressure,
+};
+
+/* Round robin among least loaded workers, selection and load updates are
+ * O(1), hold mail while every worker reaches the threshold, up to
+ * `hold_capacity` mails. */
+Policy MinLoad(size_t load_threshold_to_hold = kDefaultLoadThreshold,
+               size_t hold_capacity = kUnboundedHold,
+               Overflow overflow = Overflow::kReject);
+
+/* Sample two distinct workers at random and pick the one with less load per
+ * capacity. */
+Policy PowerOfTwoChoices();
+
+/* Weighted round robin, each worker is selected in proportion to its
+ * capacity with its turns spread evenly. Selection is O(1). */
+Policy WeightedRoundRobin();
+
+/* Power of two choices on expected latency, (load + 1) * EWMA latency, so a
+ * slow worker attracts less traffic even with few requests outstanding. */
+Policy MinLatency();
+
+/* Least outstanding among workers in this actor system, spill over to the
+ * least outstanding worker of any node once every local one reaches the
+ * threshold. Selection and load updates are O(1). */
+Policy LocalFirst(size_t load_threshold_to_spill = kDefaultLoadThreshold);
+
+using KeyOf = std::function<size_t(const caf::type_erased_tuple &content)>;
+
+static constexpr const size_t kDefaultVirtualNodes{64};
+
+/* Route mails with the same key to the same worker, only keys owned by the
+ * changed workers move when workers join or leave. */
+Policy ConsistentHash(KeyOf key_of,
+                      size_t virtual_nodes = kDefaultVirtualNodes);
 }  // namespace policy
 }  // namespace cdcf::load_balancer
 
@@ -18,8 +18,10 @@ class MessagePriorityActor : public caf::event_based_actor {
   void enqueue(caf::mailbox_element_ptr ptr, caf::execution_unit* eu) override;
 
  private:
-  bool IsFirstElementHighPriorityAtom(const caf::message& message);
-  bool IsFirstElementNormalPriorityAtom(const caf::message& message);
+  bool IsFirstElementHighPriorityAtom(const caf::type_erased_tuple& content);
+  bool IsFirstElementNormalPriorityAtom(const caf::type_erased_tuple& content);
+  bool IsFirstElementAtom(const caf::type_erased_tuple& content,
+                          caf::atom_value atom);
   void DeleteFirstElement(caf::message& message);
   void AddMessageIdWithHighPriority(caf::message_id& id);
 };
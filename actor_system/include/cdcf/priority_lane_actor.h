@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#ifndef ACTOR_SYSTEM_INCLUDE_CDCF_PRIORITY_LANE_ACTOR_H_
+#define ACTOR_SYSTEM_INCLUDE_CDCF_PRIORITY_LANE_ACTOR_H_
+
+#include <deque>
+#include <vector>
+
+#include <caf/all.hpp>
+
+#include "cdcf/message_priority_actor.h"
+#include "cdcf/scheduling_actor.h"
+
+namespace cdcf {
+using lane_atom = caf::atom_constant<caf::atom("lane")>;
+
+/* Actor with any number of priority lanes served by deficit round robin, so
+ * urgent mails are handled first without starving the others.
+ *
+ * Mail is sent to a lane as (lane_atom, lane, args...), lane 0 being the most
+ * urgent, high_priority_atom and normal_priority_atom stand for the first and
+ * the last lane. Tags are stripped before the mail is handled, untagged mail
+ * goes to the last lane.
+ *
+ * Each round, a lane with mails waiting gets as many handled as its weight. */
+class PriorityLaneActor : public SchedulingActor {
+ public:
+  explicit PriorityLaneActor(caf::actor_config& cfg,
+                             std::vector<size_t> weights = {8, 1},
+                             size_t batch = 1);
+
+ protected:
+  void Push(caf::mailbox_element_ptr ptr, caf::execution_unit* eu) override;
+  caf::mailbox_element_ptr Pop(caf::execution_unit* eu) override;
+
+ private:
+  /* lane of the mail, strip its tag if there's one. */
+  size_t LaneOf(caf::mailbox_element_ptr& ptr);
+
+  std::vector<std::deque<caf::mailbox_element_ptr>> lanes_;
+  std::vector<size_t> weights_;
+  std::vector<size_t> deficits_;
+  size_t current_{0};
+  size_t waiting_{0};
+};
+}  // namespace cdcf
+
+#endif  // ACTOR_SYSTEM_INCLUDE_CDCF_PRIORITY_LANE_ACTOR_H_
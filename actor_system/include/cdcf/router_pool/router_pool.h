@@ -5,7 +5,11 @@
 #ifndef ACTOR_SYSTEM_INCLUDE_CDCF_ROUTER_POOL_ROUTER_POOL_H_
 #define ACTOR_SYSTEM_INCLUDE_CDCF_ROUTER_POOL_ROUTER_POOL_H_
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <tuple>
@@ -16,11 +20,39 @@
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
+#include "cdcf/load_balancer/load_balancer.h"
 
 namespace cdcf::router_pool {
 
 using node_atom = caf::atom_constant<caf::atom("node")>;
 using actor_atom = caf::atom_constant<caf::atom("actor")>;
+using scale_atom = caf::atom_constant<caf::atom("scale")>;
+using drain_atom = caf::atom_constant<caf::atom("drain")>;
+using standby_atom = caf::atom_constant<caf::atom("standby")>;
+
+/* Bounds and watermarks of autoscaling, sent as
+ * (sys_atom, scale_atom, AutoScale). Every `interval` each node is checked
+ * for the average in-flight requests per routee and average reply latency,
+ * and resized after `patience` checks in a row beyond a watermark. */
+struct AutoScale {
+  size_t min_per_node{1};
+  /* zero disables autoscaling. */
+  size_t max_per_node{0};
+  std::chrono::milliseconds interval{1000};
+  /* grow over `high_backlog` or `high_latency`, shrink under `low_backlog`
+   * with latency under half of `high_latency`. Zero latency is ignored. */
+  double high_backlog{4};
+  double low_backlog{1};
+  std::chrono::microseconds high_latency{0};
+  size_t patience{3};
+};
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, AutoScale& x) {
+  return f(caf::meta::type_name("router_pool_autoscale"), x.min_per_node,
+           x.max_per_node, x.interval, x.high_backlog, x.low_backlog,
+           x.high_latency, x.patience);
+}
 
 class RouterPool : public caf::event_based_actor {
  public:
@@ -29,22 +61,72 @@ class RouterPool : public caf::event_based_actor {
              std::string& routee_name, caf::message& routee_args,
              std::set<std::string>& routee_mpi, size_t& default_actor_num,
              caf::actor_pool::policy& policy, bool use_ssl);
+  /* dispatch by a load balancer policy instead, which sees in-flight
+   * requests of every routee, e.g. policy::LocalFirst. */
+  RouterPool(caf::actor_config& cfg, caf::actor_system& system,
+             std::string& name, std::string& description,
+             std::string& routee_name, caf::message& routee_args,
+             std::set<std::string>& routee_mpi, size_t& default_actor_num,
+             load_balancer::Policy& policy, bool use_ssl);
   ~RouterPool() override;
   void enqueue(caf::mailbox_element_ptr, caf::execution_unit*) override;
 
  private:
+  /* called once an operation ends, maybe from another actor's thread. */
+  using Done = std::function<void(bool)>;
+
+  /* reply the result to requester of `what`. */
+  static Done ReplyTo(const caf::mailbox_element_ptr& what);
+  /* call `done` once all `count` parts end, with true if all succeed. */
+  static Done AllOf(size_t count, Done done);
+
   void Down(caf::down_msg& nsg);
-  bool AddNode(const std::string& host, uint16_t port);
+  void AddNode(const std::string& host, uint16_t port, Done done);
   bool DeleteNode(const std::string& host, uint16_t port);
   std::vector<std::string> GetNode();
-  bool ModifyMaxPerNode(size_t size);
-  bool ModifyMaxPerNode(size_t size, const std::string& host, uint16_t port);
+  void ModifyMaxPerNode(size_t size, Done done);
+  void ModifyMaxPerNode(size_t size, const std::string& host, uint16_t port,
+                        Done done);
   bool DeleteActor(const std::string& key, size_t num);
-  bool DeleteActor(caf::actor_addr& actor);
-  bool AddActor(const caf::actor& gateway, const std::string& key);
+  /* return false unless `actor` is an active routee, `key` is its node. */
+  bool DeleteActor(const caf::actor_addr& actor, std::string& key);
+  /* take `actor` out of routing, then stop it once it has worked off its
+   * mailbox, or at the drain deadline at the latest. Must hold actor_lock_. */
+  void Retire(const caf::actor& actor);
+  bool AddLocalActor(const std::string& key, bool standby);
+  /* ask `gateway` for all `count` routees in one spawn request, falling back
+   * to one request per routee if it can't spawn many. Routees are added as
+   * the responses arrive. */
+  void SpawnRemote(const caf::actor& gateway, const std::string& key,
+                   size_t count, Done done, bool standby);
+  /* routees of `key` being spawned and not cancelled by a shrink since, must
+   * hold actor_lock_. */
+  size_t Spawning(const std::string& key) const;
+  /* `actors` spawned for `requested` of the pending routees of `key`, as many
+   * as cancelled are stopped instead of added. */
+  void AddRemoteActors(const std::string& key, size_t requested,
+                       const std::vector<caf::actor>& actors, bool standby);
+  /* keep `size` standby routees spawned per node, not routed to until one
+   * is promoted to replace an active routee gone down. */
+  void SetStandby(size_t size);
+  void Promote(const std::string& key);
+  /* return false unless `actor` is a standby routee, `key` is its node. */
+  bool DropStandby(const caf::actor_addr& actor, std::string& key);
+  /* spawn standby routees missing in the node, asynchronously if remote. */
+  void Replenish(const std::string& key);
   std::vector<caf::actor> GetActors();
   std::vector<caf::actor> GetActors(const std::string& host, uint16_t port);
+  /* connect to gateway of the node once, later calls reuse the cached one. */
   caf::actor GetSpawnActor(const std::string& host, uint16_t port);
+  /* return false unless the pool is dispatched by a load balancer policy,
+   * whose stats autoscaling relies on. */
+  bool EnableAutoScale(const AutoScale& config);
+  /* ask pool for stats each tick, until autoscaling is disabled. */
+  void ScaleTick();
+  void Scale(const load_balancer::Stats& stats);
+  /* drop gateway from cache, return false if it isn't a gateway. */
+  bool ForgetGateway(const caf::actor_addr& gateway);
+  void ForgetGateway(const std::string& key);
 
   static std::string BuildNodeKey(const std::string& host, uint16_t port);
   static std::tuple<std::string, uint16_t> ParserNodeKey(
@@ -63,6 +145,33 @@ class RouterPool : public caf::event_based_actor {
   std::mutex actor_lock_;
   // name(host:port) -- actors
   std::unordered_map<std::string, std::unordered_set<caf::actor>> nodes_;
+  // routee -- name(host:port) of its node, so down handling is O(1)
+  std::unordered_map<caf::actor_addr, std::string> owners_;
+  size_t standby_per_node_{0};
+  // name(host:port) -- standby routees, and count of them being spawned
+  std::unordered_map<std::string, std::vector<caf::actor>> standbys_;
+  std::unordered_map<std::string, size_t> standby_pending_;
+  // standby routee -- name(host:port) of its node
+  std::unordered_map<caf::actor_addr, std::string> standby_owners_;
+  // name(host:port) -- count of routees being spawned
+  std::unordered_map<std::string, size_t> pending_;
+  // name(host:port) -- count of pending routees to stop once they arrive
+  std::unordered_map<std::string, size_t> cancelled_;
+  std::mutex gateway_lock_;
+  const bool balanced_;
+  AutoScale autoscale_;
+  // guarded by actor_lock_, set by (sys_atom, drain_atom, timespan)
+  caf::timespan drain_timeout_;
+  std::atomic<bool> scaling_{false};
+  /* checks in a row a node is beyond the high or low watermark. */
+  struct Trend {
+    size_t above{0};
+    size_t below{0};
+  };
+  // name(host:port) -- trend since last resize, guarded by actor_lock_
+  std::unordered_map<std::string, Trend> trends_;
+  // name(host:port) -- gateway connected, monitored until it's down
+  std::unordered_map<std::string, caf::actor> gateways_;
 };
 
 }  // namespace cdcf::router_pool
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#ifndef ACTOR_SYSTEM_INCLUDE_CDCF_SCHEDULING_ACTOR_H_
+#define ACTOR_SYSTEM_INCLUDE_CDCF_SCHEDULING_ACTOR_H_
+
+#include <mutex>
+#include <vector>
+
+#include <caf/all.hpp>
+
+namespace cdcf {
+/* Event based actor deciding the order its mails are handled in. Mails are
+ * held by the derived actor and passed to the mailbox `batch` at a time, once
+ * the ones passed before are handled, so a mail jumping the queue waits for
+ * one batch at most. Responses and urgent system messages skip the queue. */
+class SchedulingActor : public caf::event_based_actor {
+ public:
+  explicit SchedulingActor(caf::actor_config& cfg, size_t batch = 1);
+
+  void enqueue(caf::mailbox_element_ptr ptr, caf::execution_unit* eu) override;
+  resume_result resume(caf::execution_unit* eu, size_t max_throughput) override;
+
+ protected:
+  /* hold the mail until it's popped, lock is held. */
+  virtual void Push(caf::mailbox_element_ptr ptr, caf::execution_unit* eu) = 0;
+  /* next mail to handle, null if none is held, lock is held. */
+  virtual caf::mailbox_element_ptr Pop(caf::execution_unit* eu) = 0;
+
+  /* replace the mail by one without its first `count` elements. */
+  static void StripTag(caf::mailbox_element_ptr& ptr, size_t count);
+
+  /* deliver `mail` to `receiver` once the lock is released, as the receiver
+   * may be sending to this actor at the same time. Lock is held. */
+  void Post(caf::strong_actor_ptr receiver, caf::mailbox_element_ptr mail);
+
+ private:
+  struct Outgoing {
+    /* null for the mailbox of this actor. */
+    caf::strong_actor_ptr receiver;
+    caf::mailbox_element_ptr mail;
+  };
+
+  /* pass mails to the mailbox up to batch, lock must be held. */
+  void Release(caf::execution_unit* eu);
+
+  /* deliver mails taken from outbox_, lock must not be held. */
+  void Deliver(std::vector<Outgoing>& outgoing, caf::execution_unit* eu);
+
+  std::mutex mutex_;
+  /* mails to deliver once the lock is released. */
+  std::vector<Outgoing> outbox_;
+  /* passed to the mailbox and maybe not handled yet. */
+  size_t released_{0};
+  size_t batch_;
+  bool closed_{false};
+};
+}  // namespace cdcf
+
+#endif  // ACTOR_SYSTEM_INCLUDE_CDCF_SCHEDULING_ACTOR_H_
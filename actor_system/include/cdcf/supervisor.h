@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#ifndef ACTOR_SYSTEM_INCLUDE_CDCF_SUPERVISOR_H_
+#define ACTOR_SYSTEM_INCLUDE_CDCF_SUPERVISOR_H_
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "caf/all.hpp"
+#include "cdcf/actor_monitor.h"
+
+namespace cdcf {
+using supervise_atom = caf::atom_constant<caf::atom("supervise")>;
+using restart_atom = caf::atom_constant<caf::atom("restart")>;
+
+enum class supervisor_error : uint8_t {
+  spawn_failed = 1,
+  restart_intensity_reached
+};
+
+caf::error make_error(supervisor_error x);
+std::string to_string(supervisor_error x);
+
+/* A supervised child, `spawn` makes it and every replacement of it, locally or
+ * on a remote node. It returns null if it fails. It runs on a thread of its
+ * own, so it may block, e.g. on a remote spawn request. */
+struct ChildSpec {
+  std::string name;
+  std::function<caf::actor()> spawn;
+};
+
+enum class RestartStrategy {
+  /* restart the failed child only. */
+  one_for_one,
+  /* restart all children. */
+  one_for_all,
+  /* restart the failed child and the ones supervised after it. */
+  rest_for_one
+};
+
+struct SupervisorPolicy {
+  RestartStrategy strategy = RestartStrategy::one_for_one;
+  /* supervisor gives up and quits once children fail more than max_restarts
+   * times in a period. */
+  size_t max_restarts = 3;
+  std::chrono::milliseconds period{5000};
+  /* delay before a restart, doubled for each restart in the period. */
+  std::chrono::milliseconds backoff{100};
+  std::chrono::milliseconds max_backoff{5000};
+};
+
+/* ActorMonitor restarting the children it supervises when they fail, children
+ * exiting normally aren't restarted. A supervisor giving up quits with
+ * restart_intensity_reached, so supervisors can be supervised in turn.
+ * Children are stopped when their supervisor quits.
+ *
+ * Handles:
+ *   (supervise_atom, ChildSpec) -> caf::actor, spawn and supervise a child.
+ *   (get_atom, name) -> caf::actor, current actor of a child, null while it's
+ *     restarting.
+ *   (delete_atom, name), stop supervising a child, leave it running. */
+class Supervisor : public ActorMonitor {
+ public:
+  explicit Supervisor(caf::actor_config& cfg, SupervisorPolicy policy = {});
+  caf::behavior make_behavior() override;
+  void on_exit() override;
+
+ protected:
+  void OnDown(const caf::down_msg& down_msg) override;
+
+ private:
+  struct Child {
+    ChildSpec spec;
+    uint64_t id;
+    /* null while it's restarting. */
+    caf::actor actor;
+    /* a start is in flight, `attempt` tells it from ones overtaken by a stop. */
+    bool starting{false};
+    uint64_t attempt{0};
+    /* answers the supervise request once the first start ends. */
+    caf::response_promise promise;
+  };
+
+  std::vector<Child>::iterator Find(const caf::actor_addr& actor);
+  std::vector<Child>::iterator Find(const std::string& name);
+  std::vector<Child>::iterator Find(uint64_t id);
+  /* spawn the child on a detached helper, Started is called with the result,
+   * so children start in parallel and the supervisor never blocks. */
+  void Start(Child& child);
+  void Started(uint64_t id, uint64_t attempt, caf::actor actor);
+  void Stop(Child& child);
+  /* start all children waiting for restart. */
+  void Restart();
+  /* count a failure and schedule a restart after backoff unless one is,
+   * quit if intensity is reached. */
+  void ScheduleRestart();
+
+  SupervisorPolicy policy_;
+  std::vector<Child> children_;
+  uint64_t next_id_ = 0;
+  /* failures in the current period. */
+  std::deque<std::chrono::steady_clock::time_point> restarts_;
+  bool restart_scheduled_ = false;
+};
+}  // namespace cdcf
+
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(cdcf::ChildSpec)
+
+#endif  // ACTOR_SYSTEM_INCLUDE_CDCF_SUPERVISOR_H_
@@ -4,6 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
 #include "cdcf/actor_guard.h"
 #include "cdcf/actor_union.h"
 
@@ -189,6 +194,95 @@ TEST_F(ActorUnionTest, should_failed_when_actor_exceed_timeout) {
   EXPECT_EQ(error, true);
 }
 
+TEST_F(ActorUnionTest, should_pipeline_async_requests) {
+  actorUnion_.AddActor(calculator1_);
+  actorUnion_.AddActor(calculator2_);
+  const int requests = 100;
+  std::atomic<int> sum{0};
+  std::atomic<int> left{requests};
+  std::promise<void> done;
+
+  for (int i = 0; i < requests; ++i) {
+    actorUnion_.AsyncSendAndReceive(
+        [&](int return_value) {
+          sum += return_value;
+          if (--left == 0) {
+            done.set_value();
+          }
+        },
+        [&](const caf::error&) {
+          if (--left == 0) {
+            done.set_value();
+          }
+        },
+        add_atom::value, i, 1);
+  }
+  done.get_future().get();
+
+  EXPECT_EQ(requests * (requests + 1) / 2, sum.load());
+}
+
+TEST_F(ActorUnionTest, should_retry_async_request_on_another_actor) {
+  actorUnion_.AddActor(calculator2_);
+  actorUnion_.AddActor(calculator1_);
+  caf::anon_send_exit(calculator2_, caf::exit_reason::kill);
+  std::promise<int> promise;
+
+  actorUnion_.AsyncSendAndReceive(
+      [&](int return_value) { promise.set_value(return_value); },
+      [&](const caf::error&) { promise.set_value(0); }, add_atom::value, 3,
+      5);
+
+  EXPECT_EQ(8, promise.get_future().get());
+}
+
+TEST_F(ActorUnionTest, should_skip_failed_actor_while_its_circuit_is_open) {
+  auto hits = std::make_shared<std::atomic<int>>(0);
+  auto failing = system_.spawn([hits](caf::event_based_actor*) {
+    return caf::behavior{[hits](add_atom, int, int) {
+      ++*hits;
+      return caf::make_error(caf::sec::bad_function_call);
+    }};
+  });
+  actorUnion_.AddActor(failing);
+  actorUnion_.AddActor(calculator1_);
+
+  int sum = 0;
+  for (int i = 0; i < 4; ++i) {
+    actorUnion_.SendAndReceive([&](int return_value) { sum += return_value; },
+                               [&](const caf::error&) {}, add_atom::value, 3,
+                               5);
+  }
+
+  EXPECT_EQ(32, sum);
+  EXPECT_EQ(1, hits->load());
+}
+
+TEST_F(ActorUnionTest, should_skip_actor_timed_out_on_first_try) {
+  auto hits = std::make_shared<std::atomic<int>>(0);
+  auto slow = system_.spawn([hits](caf::event_based_actor*) {
+    return caf::behavior{[hits](add_atom, int a, int b) {
+      ++*hits;
+      std::this_thread::sleep_for(std::chrono::seconds(2));
+      return a + b;
+    }};
+  });
+  cdcf::ActorUnion actor_union{system_, caf::actor_pool::round_robin(),
+                               std::chrono::seconds(1)};
+  actor_union.AddActor(slow);
+  actor_union.AddActor(calculator1_);
+
+  int sum = 0;
+  for (int i = 0; i < 3; ++i) {
+    actor_union.SendAndReceive([&](int return_value) { sum += return_value; },
+                               [&](const caf::error&) {}, add_atom::value, 3,
+                               5);
+  }
+
+  EXPECT_EQ(24, sum);
+  EXPECT_EQ(1, hits->load());
+}
+
 class ActorGuardTest : public ::testing::Test {
   void SetUp() override {
     calculator1_ = system_.spawn(calculator_fun);
@@ -360,3 +454,41 @@ TEST_F(ActorGuardTest, should_failed_when_actor_exceed_timeout) {
   promise.get_future().get();
   EXPECT_EQ(error, true);
 }
+
+TEST_F(ActorGuardTest, should_replay_async_requests_after_one_restart) {
+  std::atomic<int> restarts{0};
+  cdcf::ActorGuard actor_guard(
+      calculator1_,
+      [&](std::atomic<bool>& active) -> caf::actor {
+        ++restarts;
+        return system_.spawn(calculator_fun);
+      },
+      system_);
+  caf::anon_send_exit(calculator1_, caf::exit_reason::kill);
+  caf::scoped_actor self(system_);
+  self->wait_for(calculator1_);
+
+  const int requests = 20;
+  std::atomic<int> sum{0};
+  std::atomic<int> left{requests};
+  std::promise<void> done;
+  for (int i = 0; i < requests; ++i) {
+    actor_guard.AsyncSendAndReceive(
+        [&](int return_value) {
+          sum += return_value;
+          if (--left == 0) {
+            done.set_value();
+          }
+        },
+        [&](const caf::error&) {
+          if (--left == 0) {
+            done.set_value();
+          }
+        },
+        add_atom::value, 3, 5);
+  }
+  done.get_future().get();
+
+  EXPECT_EQ(requests * 8, sum.load());
+  EXPECT_EQ(1, restarts.load());
+}
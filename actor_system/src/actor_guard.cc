@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#include "cdcf/actor_guard.h"
+
+namespace cdcf {
+
+caf::actor GuardedActor::Await() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  restarted_.wait(lock, [this] { return !restarting_; });
+  return active_ ? actor_ : caf::actor{};
+}
+
+void GuardedActor::WhenReady(Ready ready) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (restarting_) {
+    waiting_.push_back(std::move(ready));
+    return;
+  }
+  auto actor = active_ ? actor_ : caf::actor{};
+  lock.unlock();
+  ready(actor);
+}
+
+void GuardedActor::Restart(caf::actor_system& system, const caf::actor& failed,
+                           Ready ready) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (restarting_ || actor_ != failed || !active_) {
+    lock.unlock();
+    WhenReady(std::move(ready));
+    return;
+  }
+  restarting_ = true;
+  waiting_.push_back(std::move(ready));
+  lock.unlock();
+  // restart may block, keep it off the scheduler's threads
+  system.spawn<caf::detached>(
+      [guarded = shared_from_this()] { guarded->DoRestart(); });
+}
+
+caf::actor GuardedActor::RestartNow(const caf::actor& failed) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  restarted_.wait(lock, [this] { return !restarting_; });
+  if (actor_ == failed && active_) {
+    restarting_ = true;
+    lock.unlock();
+    DoRestart();
+    lock.lock();
+  }
+  return active_ ? actor_ : caf::actor{};
+}
+
+void GuardedActor::DoRestart() {
+  auto actor = restart_(active_);
+  std::vector<Ready> waiting;
+  caf::actor ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+      actor_ = std::move(actor);
+      ready = actor_;
+    }
+    restarting_ = false;
+    waiting.swap(waiting_);
+  }
+  restarted_.notify_all();
+  for (auto& waiter : waiting) {
+    waiter(ready);
+  }
+}
+
+}  // namespace cdcf
@@ -17,32 +17,12 @@ ActorMonitor::ActorMonitor(
     : event_based_actor(cfg), down_msg_fun(std::move(downMsgFun)) {}
 
 caf::behavior ActorMonitor::make_behavior() {
-  set_down_handler([=](const caf::down_msg& msg) {
-    std::string description;
-
-    {
-      std::lock_guard<std::mutex> locker(actor_map_lock);
-      description = actor_map_[caf::to_string(msg.source)];
-    }
-
-    if (down_msg_fun != nullptr) {
-      down_msg_fun(msg, description);
-    } else {
-      DownMsgHandle(msg, description);
-    }
-  });
+  set_down_handler([=](const caf::down_msg& msg) { OnDown(msg); });
 
   return {
       [=](const std::string& msg) { std::cout << msg << std::endl; },
       [=](const caf::actor_addr& actor_addr, const std::string& description) {
-        {
-          std::lock_guard<std::mutex> locker(actor_map_lock);
-          actor_map_[caf::to_string(actor_addr)] = description;
-        }
-
-        CDCF_LOGGER_INFO(
-            "monitor new actor, actor addr:{} actor description:{}",
-            caf::to_string(actor_addr), description);
+        Describe(actor_addr, description);
       },
       [=](demonitor_atom, const std::string& actor_addr) {
         std::string description;
@@ -57,6 +37,37 @@ caf::behavior ActorMonitor::make_behavior() {
       }};
 }
 
+void ActorMonitor::OnDown(const caf::down_msg& down_msg) {
+  std::string description;
+
+  {
+    std::lock_guard<std::mutex> locker(actor_map_lock);
+    description = actor_map_[caf::to_string(down_msg.source)];
+  }
+
+  if (down_msg_fun != nullptr) {
+    down_msg_fun(down_msg, description);
+  } else {
+    DownMsgHandle(down_msg, description);
+  }
+}
+
+void ActorMonitor::Describe(const caf::actor_addr& actor_addr,
+                            const std::string& description) {
+  {
+    std::lock_guard<std::mutex> locker(actor_map_lock);
+    actor_map_[caf::to_string(actor_addr)] = description;
+  }
+
+  CDCF_LOGGER_INFO("monitor new actor, actor addr:{} actor description:{}",
+                   caf::to_string(actor_addr), description);
+}
+
+void ActorMonitor::Forget(const caf::actor_addr& actor_addr) {
+  std::lock_guard<std::mutex> locker(actor_map_lock);
+  actor_map_.erase(caf::to_string(actor_addr));
+}
+
 void ActorMonitor::DownMsgHandle(const caf::down_msg& down_msg,
                                  const std::string& description) {
   std::stringstream buffer;
@@ -4,27 +4,254 @@
 
 #include "cdcf/actor_union.h"
 
+#include <algorithm>
+#include <memory>
+#include <utility>
+
 namespace cdcf {
+namespace {
+/* Stands in for a member in the pool, logs which member a request is routed
+ * to and passes it on right away, on the caller's thread. */
+class MemberRoute : public caf::monitorable_actor {
+ public:
+  MemberRoute(caf::actor_config& config, caf::actor member,
+        std::shared_ptr<RouteLog> log)
+      : caf::monitorable_actor(config),
+        member_(std::move(member)),
+        log_(std::move(log)) {}
+
+  void enqueue(caf::mailbox_element_ptr what,
+               caf::execution_unit* host) override {
+    if (what->mid.is_request() && what->sender) {
+      log_->Record(what->sender, what->mid, member_.address());
+    }
+    member_->enqueue(std::move(what), host);
+  }
+
+  void on_destroy() override {
+    CAF_PUSH_AID_FROM_PTR(this);
+    if (!getf(is_cleaned_up_flag)) {
+      cleanup(caf::exit_reason::unreachable, nullptr);
+      monitorable_actor::on_destroy();
+      unregister_from_system();
+    }
+  }
+
+  static caf::actor Make(caf::execution_unit* host, caf::actor member,
+                         std::shared_ptr<RouteLog> log) {
+    auto& sys = host->system();
+    caf::actor_config config{host};
+    return caf::make_actor<MemberRoute, caf::actor>(
+        sys.next_actor_id(), sys.node(), &sys, config, std::move(member),
+        std::move(log));
+  }
+
+ private:
+  caf::actor member_;
+  std::shared_ptr<RouteLog> log_;
+};
+}  // namespace
+
+constexpr std::chrono::seconds MemberHealth::kBaseBackoff;
+constexpr std::chrono::seconds MemberHealth::kMaxBackoff;
+
+void MemberHealth::Add(const caf::actor& member, const caf::actor& route) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Find(member.address()) == circuits_.end()) {
+    circuits_.push_back(Circuit{member, route});
+  }
+}
+
+void MemberHealth::Remove(const caf::actor& member) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = Find(member.address());
+  if (it != circuits_.end()) {
+    circuits_.erase(it);
+  }
+  Refresh(Clock::now());
+}
+
+void MemberHealth::Down(const caf::actor_addr& member) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = Find(member);
+  if (it != circuits_.end()) {
+    it->down = true;
+  }
+  Refresh(Clock::now());
+}
+
+void MemberHealth::Fail(const caf::actor_addr& member) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  Refresh(now);
+  auto it = Find(member);
+  if (it == circuits_.end()) {
+    return;
+  }
+  ++it->failures;
+  it->open_until = now + Backoff(it->failures);
+  Refresh(now);
+}
+
+std::vector<caf::actor> MemberHealth::Filter(
+    const std::vector<caf::actor>& routes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  Refresh(now);
+  std::vector<caf::actor> closed;
+  std::vector<caf::actor> alive;
+  for (const auto& route : routes) {
+    auto it = FindRoute(route.address());
+    if (it == circuits_.end()) {
+      closed.push_back(route);
+    } else if (!it->down) {
+      alive.push_back(route);
+      if (it->open_until <= now) {
+        closed.push_back(route);
+      }
+    }
+  }
+  if (!closed.empty()) {
+    return closed;
+  }
+  // policy needs someone to route to, let it fail on the least bad one
+  return alive.empty() ? routes : alive;
+}
+
+caf::actor MemberHealth::Pick(const std::vector<caf::actor_addr>& tried) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  Refresh(now);
+  for (size_t i = 0; i < circuits_.size(); ++i) {
+    auto& circuit = circuits_[(cursor_ + i) % circuits_.size()];
+    if (circuit.down || circuit.open_until > now ||
+        std::find(tried.begin(), tried.end(), circuit.member.address()) !=
+            tried.end()) {
+      continue;
+    }
+    cursor_ = (cursor_ + i + 1) % circuits_.size();
+    return circuit.member;
+  }
+  return {};
+}
+
+MemberHealth::Clock::duration MemberHealth::Backoff(uint32_t failures) {
+  // shift is capped, kMaxBackoff is reached long before
+  auto backoff = kBaseBackoff * (1u << std::min(failures - 1, 16u));
+  return std::min<Clock::duration>(backoff, kMaxBackoff);
+}
+
+void MemberHealth::Refresh(Clock::time_point now) {
+  size_t unhealthy = 0;
+  for (auto& circuit : circuits_) {
+    if (circuit.failures > 0 && !circuit.down &&
+        circuit.open_until + Backoff(circuit.failures) <= now) {
+      circuit.failures = 0;
+    }
+    if (circuit.down || circuit.failures > 0) {
+      ++unhealthy;
+    }
+  }
+  unhealthy_ = unhealthy;
+}
+
+std::vector<MemberHealth::Circuit>::iterator MemberHealth::Find(
+    const caf::actor_addr& member) {
+  return std::find_if(circuits_.begin(), circuits_.end(),
+                      [&](const Circuit& circuit) {
+                        return circuit.member.address() == member;
+                      });
+}
+
+std::vector<MemberHealth::Circuit>::iterator MemberHealth::FindRoute(
+    const caf::actor_addr& route) {
+  return std::find_if(circuits_.begin(), circuits_.end(),
+                      [&](const Circuit& circuit) {
+                        return circuit.route.address() == route;
+                      });
+}
+
+void RouteLog::Record(const caf::strong_actor_ptr& sender, caf::message_id id,
+                      const caf::actor_addr& member) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  members_[{caf::actor_cast<caf::actor_addr>(sender), id.integer_value()}] =
+      member;
+}
+
+caf::actor_addr RouteLog::Take(const caf::actor_addr& sender,
+                               caf::message_id id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = members_.find({sender, id.integer_value()});
+  if (it == members_.end()) {
+    return {};
+  }
+  auto member = std::move(it->second);
+  members_.erase(it);
+  return member;
+}
+
+void RouteLog::Forget(const caf::actor_addr& sender) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto first = members_.lower_bound({sender, 0});
+  auto last = first;
+  while (last != members_.end() && last->first.first == sender) {
+    ++last;
+  }
+  members_.erase(first, last);
+}
 
 ActorUnion::ActorUnion(caf::actor_system& system,
                        caf::actor_pool::policy policy,
                        std::chrono::seconds timeout_in_seconds)
-    : sender_actor_(system), timeout_in_seconds_(timeout_in_seconds) {
+    : system_(system),
+      sender_actor_(system),
+      timeout_in_seconds_(timeout_in_seconds) {
   context_ = new caf::scoped_execution_unit(&system);
-  pool_actor_ = caf::actor_pool::make(context_, std::move(policy));
+  // first tries skip members known to fail, when there's any
+  pool_actor_ = caf::actor_pool::make(
+      context_, [health = health_, policy = std::move(policy)](
+                    caf::actor_system& sys, caf::actor_pool::uplock& guard,
+                    const caf::actor_pool::actor_vec& members,
+                    caf::mailbox_element_ptr& mail, caf::execution_unit* host) {
+        if (health->AllHealthy()) {
+          policy(sys, guard, members, mail, host);
+          return;
+        }
+        policy(sys, guard, health->Filter(members), mail, host);
+      });
 }
 
 ActorUnion::~ActorUnion() { delete context_; }
 
 void ActorUnion::AddActor(const caf::actor& actor) {
+  if (routes_.find(actor) != routes_.end()) {
+    return;
+  }
+  auto route = MemberRoute::Make(context_, actor, log_);
+  routes_.emplace(actor, route);
   caf::anon_send(pool_actor_, caf::sys_atom::value, caf::put_atom::value,
-                 actor);
+                 route);
+  health_->Add(actor, route);
+  actor->attach_functor([health = health_, member = actor.address(),
+                         pool = pool_actor_.address(),
+                         route = route.address()](const caf::error&) {
+    health->Down(member);
+    // pool sees the route only, which never goes down itself
+    caf::anon_send(caf::actor_cast<caf::actor>(pool), caf::sys_atom::value,
+                   caf::delete_atom::value, caf::actor_cast<caf::actor>(route));
+  });
   actor_count_++;
 }
 
 void ActorUnion::RemoveActor(const caf::actor& actor) {
+  auto route = routes_.find(actor);
+  if (route == routes_.end()) {
+    return;
+  }
   caf::anon_send(pool_actor_, caf::sys_atom::value, caf::delete_atom::value,
-                 actor);
+                 route->second);
+  routes_.erase(route);
+  health_->Remove(actor);
   actor_count_--;
 }
 
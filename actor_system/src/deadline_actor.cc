@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#include "cdcf/deadline_actor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cdcf {
+
+DeadlineActor::DeadlineActor(caf::actor_config& cfg, size_t batch)
+    : SchedulingActor(cfg, batch) {}
+
+void DeadlineActor::Push(caf::mailbox_element_ptr ptr,
+                         caf::execution_unit* eu) {
+  auto now = caf::make_timestamp();
+  auto deadline = caf::timestamp::max();
+  const auto& content = ptr->content();
+  if (content.size() > 1 && content.match_element<caf::atom_value>(0) &&
+      content.get_as<caf::atom_value>(0) == deadline_atom::value) {
+    if (content.match_element<caf::timestamp>(1)) {
+      deadline = content.get_as<caf::timestamp>(1);
+      StripTag(ptr, 2);
+    } else if (content.match_element<caf::timespan>(1)) {
+      deadline = now + content.get_as<caf::timespan>(1);
+      StripTag(ptr, 2);
+    }
+  }
+  if (deadline < now) {
+    Miss(std::move(ptr));
+    return;
+  }
+  heap_.push_back(Entry{deadline, sequence_++, std::move(ptr)});
+  std::push_heap(heap_.begin(), heap_.end(), Later);
+}
+
+caf::mailbox_element_ptr DeadlineActor::Pop(caf::execution_unit* eu) {
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), Later);
+    auto entry = std::move(heap_.back());
+    heap_.pop_back();
+    if (entry.deadline < caf::make_timestamp()) {
+      Miss(std::move(entry.mail));
+      continue;
+    }
+    return std::move(entry.mail);
+  }
+  return nullptr;
+}
+
+bool DeadlineActor::Later(const Entry& lhs, const Entry& rhs) {
+  return lhs.deadline != rhs.deadline ? lhs.deadline > rhs.deadline
+                                      : lhs.sequence > rhs.sequence;
+}
+
+void DeadlineActor::Miss(caf::mailbox_element_ptr ptr) {
+  ++missed_;
+  if (!ptr->mid.is_request()) {
+    return;
+  }
+  // answer as a response promise would
+  auto error =
+      caf::make_message(make_error(deadline_actor_error::deadline_missed));
+  if (ptr->stages.empty()) {
+    if (ptr->sender) {
+      Post(ptr->sender,
+           caf::make_mailbox_element(caf::strong_actor_ptr{ctrl()},
+                                     ptr->mid.response_id(), {},
+                                     std::move(error)));
+    }
+    return;
+  }
+  auto next = std::move(ptr->stages.back());
+  ptr->stages.pop_back();
+  Post(std::move(next),
+       caf::make_mailbox_element(std::move(ptr->sender),
+                                 ptr->mid.response_id(),
+                                 std::move(ptr->stages), std::move(error)));
+}
+
+caf::error make_error(deadline_actor_error x) {
+  return {static_cast<uint8_t>(x), caf::atom("deadline")};
+}
+
+std::string to_string(deadline_actor_error x) {
+  switch (x) {
+    case deadline_actor_error::deadline_missed:
+      return "deadline missed";
+    default:
+      return "-unknown-error-";
+  }
+}
+
+}  // namespace cdcf
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#include "cdcf/deadline_actor.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using hold_atom = caf::atom_constant<caf::atom("hold")>;
+
+class DeadlineRecorder : public cdcf::DeadlineActor {
+ public:
+  explicit DeadlineRecorder(caf::actor_config& cfg, size_t batch = 1)
+      : cdcf::DeadlineActor(cfg, batch) {}
+
+  caf::behavior make_behavior() override {
+    return {[=](hold_atom) {
+              std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            },
+            [=](int value) { return value; },
+            [=](int value, bool) { handled_.push_back(value); },
+            [=](caf::get_atom) { return handled_; }};
+  }
+
+ private:
+  std::vector<int> handled_;
+};
+
+class DeadlineActorTest : public ::testing::Test {
+ public:
+  caf::actor_system_config config_;
+  caf::actor_system system_{config_};
+  caf::actor target_ = system_.spawn<DeadlineRecorder>();
+  caf::scoped_actor self_{system_};
+  caf::error missed_ =
+      cdcf::make_error(cdcf::deadline_actor_error::deadline_missed);
+};
+
+TEST_F(DeadlineActorTest, should_handle_earliest_deadline_first) {
+  auto now = caf::make_timestamp();
+  // keep target busy until all mails arrived
+  self_->send(target_, hold_atom::value);
+  self_->send(target_, 4, true);
+  self_->send(target_, cdcf::deadline_atom::value, now + std::chrono::hours(1),
+              3, true);
+  self_->send(target_, cdcf::deadline_atom::value,
+              caf::timespan{std::chrono::minutes(1)}, 1, true);
+  self_->send(target_, cdcf::deadline_atom::value,
+              now + std::chrono::minutes(2), 2, true);
+
+  std::vector<int> handled;
+  self_->request(target_, caf::infinite, caf::get_atom::value)
+      .receive([&](const std::vector<int>& result) { handled = result; },
+               [&](caf::error&) { ADD_FAILURE(); });
+
+  std::vector<int> expected{1, 2, 3, 4};
+  EXPECT_EQ(expected, handled);
+}
+
+TEST_F(DeadlineActorTest, should_fail_request_past_its_deadline) {
+  caf::error error;
+  self_->request(target_, caf::infinite, cdcf::deadline_atom::value,
+                 caf::make_timestamp() - std::chrono::seconds(1), 1)
+      .receive([&](int) { ADD_FAILURE(); },
+               [&](caf::error& err) { error = err; });
+  EXPECT_EQ(missed_, error);
+
+  // deadline passes while target is busy
+  self_->send(target_, hold_atom::value);
+  error = caf::error{};
+  self_->request(target_, caf::infinite, cdcf::deadline_atom::value,
+                 caf::timespan{std::chrono::milliseconds(50)}, 2)
+      .receive([&](int) { ADD_FAILURE(); },
+               [&](caf::error& err) { error = err; });
+  EXPECT_EQ(missed_, error);
+
+  int result = 0;
+  self_->request(target_, caf::infinite, cdcf::deadline_atom::value,
+                 caf::timespan{std::chrono::seconds(10)}, 3)
+      .receive([&](int value) { result = value; },
+               [&](caf::error&) { ADD_FAILURE(); });
+  EXPECT_EQ(3, result);
+}
+
+TEST_F(DeadlineActorTest, should_check_deadline_when_mail_is_released) {
+  auto target = system_.spawn<DeadlineRecorder>(size_t{2});
+  auto budget = caf::timespan{std::chrono::milliseconds(50)};
+  // hold and first request are passed to the mailbox at once, the second
+  // request is held until the batch is handled
+  self_->send(target, hold_atom::value);
+  auto first = self_->request(target, caf::infinite,
+                              cdcf::deadline_atom::value, budget, 1);
+  auto second = self_->request(target, caf::infinite,
+                               cdcf::deadline_atom::value, budget, 2);
+
+  int result = 0;
+  first.receive([&](int value) { result = value; },
+                [&](caf::error&) { ADD_FAILURE(); });
+  EXPECT_EQ(1, result);
+
+  caf::error error;
+  second.receive([&](int) { ADD_FAILURE(); },
+                 [&](caf::error& err) { error = err; });
+  EXPECT_EQ(missed_, error);
+}
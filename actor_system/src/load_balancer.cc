@@ -3,18 +3,84 @@
  */
 #include "cdcf/load_balancer/load_balancer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
 #include <caf/default_attachable.hpp>
+#include <caf/defaults.hpp>
 
+#include "src/load_balancer/batcher.h"
+#include "src/load_balancer/hedger.h"
 #include "src/load_balancer/proxy.h"
 
 namespace cdcf::load_balancer {
+namespace {
+using sweep_atom = caf::atom_constant<caf::atom("sweep")>;
+using flush_atom = caf::atom_constant<caf::atom("flush")>;
+using hedge_atom = caf::atom_constant<caf::atom("hedge")>;
+
+constexpr uint64_t kEwmaWeight = 8;
+constexpr uint64_t kThroughputWindow = 100'000;  // microseconds
+
+void Ewma(std::atomic<uint64_t> &average, uint64_t sample) {
+  sample = std::max<uint64_t>(sample, 1);
+  auto current = average.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    next = current == 0
+               ? sample
+               : (current * (kEwmaWeight - 1) + sample) / kEwmaWeight;
+  } while (!average.compare_exchange_weak(current, next,
+                                          std::memory_order_relaxed));
+}
+
+uint64_t Microseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+/* the reply closing a window folds its rate into the throughput EWMA. */
+void RecordReply(Metrics &metrics, std::chrono::steady_clock::time_point now,
+                 std::chrono::steady_clock::time_point relayed_at) {
+  Ewma(metrics.latency, Microseconds(now - relayed_at));
+  auto now_us = Microseconds(now.time_since_epoch());
+  metrics.window_replies.fetch_add(1);
+  auto start = metrics.window_start.load();
+  if (start == 0) {
+    metrics.window_start.compare_exchange_strong(start, now_us);
+    return;
+  }
+  auto elapsed = now_us > start ? now_us - start : 0;
+  if (elapsed < kThroughputWindow ||
+      !metrics.window_start.compare_exchange_strong(start, now_us)) {
+    return;
+  }
+  auto replies = metrics.window_replies.exchange(0);
+  Ewma(metrics.throughput, replies * 1'000'000 / elapsed);
+}
+}  // namespace
+
+caf::error make_error(load_balancer_error x) {
+  return {static_cast<uint8_t>(x), caf::atom("load_bal")};
+}
+
+std::string to_string(load_balancer_error x) {
+  switch (x) {
+    case load_balancer_error::overloaded:
+      return "load balancer overloaded";
+    default:
+      return "-unknown-error-";
+  }
+}
+
 Router::Router(caf::actor_config &config)
     : caf::monitorable_actor(config),
-      planned_reason_(caf::exit_reason::normal),
-      proxy_(std::make_unique<Proxy>()) {}
+      planned_reason_(caf::exit_reason::normal) {}
 
 caf::actor Router::Make(caf::execution_unit *host,
-                        load_balancer::Policy &&policy) {
+                        load_balancer::Policy &&policy,
+                        const Options &options) {
   auto &sys = host->system();
   caf::actor_config config{host};
   auto res = caf::make_actor<Router, caf::actor>(sys.next_actor_id(),
@@ -22,6 +88,18 @@ caf::actor Router::Make(caf::execution_unit *host,
   auto abstract = caf::actor_cast<caf::abstract_actor *>(res);
   auto ptr = static_cast<Router *>(abstract);
   ptr->policy_ = std::move(policy);
+  ptr->proxy_ = std::make_unique<Proxy>(
+      caf::get_or(sys.config(), "scheduler.max-threads",
+                  caf::defaults::scheduler::max_threads),
+      options.ticket_timeout, options.hedge_percentile > 0);
+  if (options.hedge_percentile > 0) {
+    ptr->hedger_ = std::make_unique<Hedger>(options.hedge_percentile,
+                                            options.hedge_budget);
+  }
+  if (options.batch_size > 1) {
+    ptr->batcher_ = std::make_unique<Batcher>(options.batch_size);
+    ptr->batch_delay_ = options.batch_delay;
+  }
   return res;
 }
 
@@ -47,16 +125,254 @@ void Router::enqueue(caf::mailbox_element_ptr what, caf::execution_unit *host) {
   }
   const auto is_response = what->mid.is_response();
   if (is_response) {
-    auto from = caf::actor_cast<caf::actor>(what->sender);
-    --metrics_[from].load;
-    proxy_->Reply(ctrl(), what, host, guard, workers_);
+    Reply(what, host);
   }
-  auto this_mail = is_response ? nullptr : std::move(what);
-  auto [to, next_mail] = policy_(workers_, GetMetrics(), this_mail);
+  Dispatch(is_response ? nullptr : std::move(what), host);
+}
+
+void Router::Dispatch(caf::mailbox_element_ptr what,
+                      caf::execution_unit *host) {
+  auto [to, next_mail] = policy_(workers_, metrics_, what);
   if (to && next_mail) {
-    ++metrics_[to].load;
-    proxy_->Relay(ctrl(), next_mail, host, guard, to);
+    auto it = index_.find(to);
+    assert(it != index_.end());
+    IncreaseLoad(it->second);
+    const auto generation = generations_[it->second];
+    if (batcher_) {
+      Batch(to, generation, next_mail, host);
+    } else if (hedger_ && next_mail->mid.is_request()) {
+      ScheduleHedge(proxy_->Relay(ctrl(), next_mail, host, to, generation));
+    } else {
+      proxy_->Relay(ctrl(), next_mail, host, to, generation);
+    }
+    if (proxy_->Expiring() && !sweeping_.load(std::memory_order_relaxed) &&
+        !sweeping_.exchange(true)) {
+      ScheduleSweep();
+    }
+  } else if (next_mail) {
+    Shed(next_mail, host);
+  }
+}
+
+void Router::Reply(caf::mailbox_element_ptr &what, caf::execution_unit *host) {
+  auto ticket = proxy_->ExtractTicket(what);
+  /* a worker removed from load balancer takes its load with it, replies of
+   * the requests it's draining are relayed all the same and don't count
+   * against it if it's added again meanwhile. */
+  const auto index = IndexOf(ticket.worker, ticket.generation);
+  const auto known = index < workers_.size();
+  auto now = std::chrono::steady_clock::now();
+  auto message = what->move_content_to_message();
+  if (ticket.batched.empty()) {
+    if (known) {
+      RecordReply(metrics_[index], now, ticket.relayed_at);
+      DecreaseLoad(index);
+      if (hedger_) {
+        hedger_->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+            now - ticket.relayed_at));
+      }
+    }
+    if (ticket.answered) {
+      /* the sibling has replied first. */
+      if (ticket.answered->exchange(true)) {
+        return;
+      }
+      auto sibling = proxy_->ExtractTicket(ticket.sibling);
+      auto sibling_index = IndexOf(sibling.worker, sibling.generation);
+      if (sibling_index < workers_.size()) {
+        DecreaseLoad(sibling_index);
+      }
+    }
+    ticket.Reply(ctrl(), message, host);
+    return;
+  }
+  /* replies of a batch come in order as one message, anything else is an
+   * error of the whole batch. */
+  const auto &batched = ticket.batched;
+  auto fan_out = message.size() == batched.size();
+  for (size_t i = 0; fan_out && i < message.size(); ++i) {
+    fan_out = message.match_element<caf::message>(i);
+  }
+  for (size_t i = 0; i < batched.size(); ++i) {
+    if (known) {
+      RecordReply(metrics_[index], now, ticket.relayed_at);
+      DecreaseLoad(index);
+    }
+    batched[i].Reply(ctrl(),
+                     fan_out ? message.get_as<caf::message>(i) : message, host);
+    /* enqueue dispatches once for the last one. */
+    if (known && i + 1 < batched.size()) {
+      Dispatch(nullptr, host);
+    }
+  }
+}
+
+void Router::Shed(caf::mailbox_element_ptr &what, caf::execution_unit *host) {
+  const auto &sender = what->sender;
+  shed_.fetch_add(1, std::memory_order_relaxed);
+  if (what->mid.is_request() && sender != nullptr) {
+    sender->enqueue(ctrl(), what->mid.response_id(),
+                    caf::make_message(
+                        make_error(load_balancer_error::overloaded)),
+                    host);
+  }
+}
+
+void Router::Sweep(caf::execution_unit *host) {
+  auto expired = proxy_->ExpireTickets(std::chrono::steady_clock::now());
+  for (auto &ticket : expired) {
+    auto index = IndexOf(ticket.worker, ticket.generation);
+    for (size_t i = 0; index < workers_.size() && i < ticket.Requests(); ++i) {
+      DecreaseLoad(index);
+      Dispatch(nullptr, host);
+    }
+    /* a hedged request is answered by whichever sibling ends first. */
+    if (ticket.answered && ticket.answered->exchange(true)) {
+      continue;
+    }
+    ticket.Reply(ctrl(),
+                 caf::make_message(caf::make_error(caf::sec::request_timeout)),
+                 host);
+  }
+  sweeping_ = false;
+  if (proxy_->Pending() > 0 && !sweeping_.exchange(true)) {
+    ScheduleSweep();
+  }
+}
+
+void Router::ScheduleSweep() {
+  caf::delayed_anon_send(caf::actor_cast<caf::actor>(this),
+                         proxy_->Resolution(), caf::sys_atom::value,
+                         sweep_atom::value);
+}
+
+void Router::Batch(const caf::actor &worker, uint64_t generation,
+                   caf::mailbox_element_ptr &what, caf::execution_unit *host) {
+  bool first = false;
+  auto batch = batcher_->Add(generation, what, first);
+  if (!batch.empty()) {
+    proxy_->RelayBatch(ctrl(), batch, host, worker, generation);
+  } else if (first) {
+    caf::delayed_anon_send(caf::actor_cast<caf::actor>(this), batch_delay_,
+                           caf::sys_atom::value, flush_atom::value, worker,
+                           generation);
+  }
+}
+
+void Router::Flush(const caf::actor &worker, uint64_t generation,
+                   caf::execution_unit *host) {
+  if (!batcher_) {
+    return;
+  }
+  auto batch = batcher_->Take(generation);
+  if (batch.empty()) {
+    return;
+  }
+  /* worker get removed while batching, its load is gone with it. */
+  if (IndexOf(worker, generation) == workers_.size()) {
+    for (auto &mail : batch) {
+      Dispatch(std::move(mail), host);
+    }
+    return;
+  }
+  if (batch.size() == 1) {
+    proxy_->Relay(ctrl(), batch.front(), host, worker, generation);
+  } else {
+    proxy_->RelayBatch(ctrl(), batch, host, worker, generation);
+  }
+}
+
+void Router::ScheduleHedge(const caf::message_id &request_id) {
+  hedger_->Relayed();
+  auto delay = hedger_->Delay();
+  /* no timer per request while there's nothing to hedge to. */
+  if (delay.count() == 0 || workers_.size() < 2) {
+    return;
+  }
+  caf::delayed_anon_send(caf::actor_cast<caf::actor>(this), delay,
+                         caf::sys_atom::value, hedge_atom::value,
+                         request_id.response_id().integer_value());
+}
+
+void Router::Hedge(const caf::message_id &response_id,
+                   caf::execution_unit *host) {
+  if (!hedger_) {
+    return;
+  }
+  auto original = proxy_->HedgeableWorker(response_id);
+  if (!original || !hedger_->TryHedge()) {
+    return;
+  }
+  auto selected = workers_.size();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (workers_[i] == original) {
+      continue;
+    }
+    if (selected == workers_.size() ||
+        metrics_[i].load * metrics_[selected].capacity <
+            metrics_[selected].load * metrics_[i].capacity) {
+      selected = i;
+    }
+  }
+  if (selected == workers_.size()) {
+    return;
+  }
+  IncreaseLoad(selected);
+  if (!proxy_->Hedge(ctrl(), response_id, host, workers_[selected],
+                     generations_[selected])) {
+    DecreaseLoad(selected);
+  }
+}
+
+Stats Router::Snapshot() const {
+  Stats result;
+  auto counters = proxy_->Count();
+  result.relayed = counters.placed;
+  result.replied = counters.extracted;
+  result.expired = counters.expired;
+  result.pending = counters.pending;
+  result.shed = shed_.load(std::memory_order_relaxed);
+  if (auto observer = policy_.Observer()) {
+    result.held = observer->Hold().held;
+  }
+  result.workers = workers_;
+  for (const auto &metrics : metrics_) {
+    result.loads.push_back(metrics.load);
+    result.latencies.push_back(metrics.latency);
+  }
+  return result;
+}
+
+void Router::IncreaseLoad(size_t index) {
+  ++metrics_[index].load;
+  if (auto observer = policy_.Observer()) {
+    observer->Increase(index);
+  }
+}
+
+void Router::DecreaseLoad(size_t index) {
+  --metrics_[index].load;
+  if (auto observer = policy_.Observer()) {
+    observer->Decrease(index);
+  }
+}
+
+void Router::Reindex() {
+  index_.clear();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    index_.emplace(workers_[i], i);
+  }
+  if (auto observer = policy_.Observer()) {
+    observer->Reset(workers_, metrics_);
+  }
+}
+
+size_t Router::IndexOf(const caf::actor &worker, uint64_t generation) const {
+  auto it = index_.find(worker);
+  if (it == index_.end() || generations_[it->second] != generation) {
+    return workers_.size();
   }
+  return it->second;
 }
 
 bool Router::Filter(Lock &guard, caf::mailbox_element_ptr &what,
@@ -73,8 +389,41 @@ bool Router::Filter(Lock &guard, caf::mailbox_element_ptr &what,
     Down(guard, eu, content.get_as<caf::down_msg>(0));
     return true;
   }
+  if (content.match_elements<caf::sys_atom, sweep_atom>()) {
+    Sweep(eu);
+    return true;
+  }
+  if (content.match_elements<caf::sys_atom, flush_atom, caf::actor,
+                             uint64_t>()) {
+    Flush(content.get_as<caf::actor>(2), content.get_as<uint64_t>(3), eu);
+    return true;
+  }
+  if (content.match_elements<caf::sys_atom, hedge_atom, uint64_t>()) {
+    Hedge(caf::make_message_id(content.get_as<uint64_t>(2)), eu);
+    return true;
+  }
   if (content.match_elements<caf::sys_atom, caf::put_atom, caf::actor>()) {
-    AddWorker(guard, content.get_as<caf::actor>(2));
+    AddWorker(guard, content.get_as<caf::actor>(2), 1);
+    return true;
+  }
+  if (content.match_elements<caf::sys_atom, caf::put_atom, caf::actor,
+                             size_t>()) {
+    const auto &worker = content.get_as<caf::actor>(2);
+    const auto capacity = content.get_as<size_t>(3);
+    auto it = index_.find(worker);
+    if (it == index_.end()) {
+      AddWorker(guard, worker, capacity);
+    } else {
+      UpdateCapacity(guard, it->second, capacity);
+    }
+    return true;
+  }
+  if (content.match_elements<caf::sys_atom, caf::join_atom, caf::actor>()) {
+    Join(guard, content.get_as<caf::actor>(2));
+    return true;
+  }
+  if (content.match_elements<caf::sys_atom, caf::leave_atom, caf::actor>()) {
+    Leave(guard, content.get_as<caf::actor>(2));
     return true;
   }
   if (content.match_elements<caf::sys_atom, caf::delete_atom, caf::actor>()) {
@@ -85,6 +434,13 @@ bool Router::Filter(Lock &guard, caf::mailbox_element_ptr &what,
     ClearWorker(guard);
     return true;
   }
+  if (content.match_elements<caf::sys_atom, caf::get_atom, stats_atom>()) {
+    auto stats = Snapshot();
+    guard.unlock();
+    sender->enqueue(nullptr, mid.response_id(),
+                    make_message(std::move(stats)), eu);
+    return true;
+  }
   if (content.match_elements<caf::sys_atom, caf::get_atom>()) {
     auto workers = workers_;
     guard.unlock();
@@ -102,29 +458,112 @@ bool Router::Filter(Lock &guard, caf::mailbox_element_ptr &what,
   return false;
 }
 
-void Router::AddWorker(Lock &guard, const caf::actor &worker) {
-  auto it = std::find(workers_.begin(), workers_.end(), worker);
-  if (it != workers_.end()) {
+void Router::AddWorker(Lock &guard, const caf::actor &worker,
+                       size_t capacity) {
+  if (index_.find(worker) != index_.end()) {
     return;
   }
   worker->attach(
       caf::default_attachable::make_monitor(worker.address(), address()));
   caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> unique_guard{guard};
   workers_.push_back(worker);
-  metrics_.emplace(worker, Metrics{});
+  metrics_.emplace_back().capacity = capacity;
+  generations_.push_back(next_generation_++);
+  Reindex();
+  auto reports = Report();
+  unique_guard.unlock();
+  Send(reports);
+}
+
+void Router::UpdateCapacity(Lock &guard, size_t index, size_t capacity) {
+  if (metrics_[index].capacity == capacity) {
+    return;
+  }
+  caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> unique_guard{guard};
+  metrics_[index].capacity = capacity;
+  Reindex();
+  auto reports = Report();
+  unique_guard.unlock();
+  Send(reports);
+}
+
+void Router::Join(Lock &guard, const caf::actor &parent) {
+  caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> unique_guard{guard};
+  if (std::find(parents_.begin(), parents_.end(), parent.address()) ==
+      parents_.end()) {
+    parents_.push_back(parent.address());
+  }
+  Reports reports;
+  Report(parent.address(), reports);
+  unique_guard.unlock();
+  Send(reports);
+}
+
+void Router::Leave(Lock &guard, const caf::actor &parent) {
+  caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> unique_guard{guard};
+  auto it = std::find(parents_.begin(), parents_.end(), parent.address());
+  if (it == parents_.end()) {
+    return;
+  }
+  parents_.erase(it);
+  unique_guard.unlock();
+  caf::anon_send(parent, caf::sys_atom::value, caf::delete_atom::value,
+                 caf::actor_cast<caf::actor>(this));
+}
+
+Router::Reports Router::Report() {
+  Reports reports;
+  for (const auto &parent : parents_) {
+    Report(parent, reports);
+  }
+  return reports;
+}
+
+void Router::Report(const caf::actor_addr &parent, Reports &reports) {
+  auto handle = caf::actor_cast<caf::actor>(parent);
+  if (!handle) {
+    return;
+  }
+  auto self = caf::actor_cast<caf::actor>(this);
+  if (workers_.empty()) {
+    reports.emplace_back(std::move(handle),
+                         caf::make_message(caf::sys_atom::value,
+                                           caf::delete_atom::value, self));
+    return;
+  }
+  size_t capacity = 0;
+  for (const auto &metrics : metrics_) {
+    capacity += metrics.capacity;
+  }
+  reports.emplace_back(std::move(handle),
+                       caf::make_message(caf::sys_atom::value,
+                                         caf::put_atom::value, self,
+                                         capacity));
+}
+
+void Router::Send(const Reports &reports) {
+  for (const auto &[parent, report] : reports) {
+    caf::anon_send(parent, report);
+  }
 }
 
 void Router::DeleteWorker(Lock &guard, const caf::actor &worker) {
   caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> unique_guard{guard};
   auto last = workers_.end();
   auto it = std::find(workers_.begin(), last, worker);
-  if (it != last) {
-    caf::default_attachable::observe_token token{
-        address(), caf::default_attachable::monitor};
-    worker->detach(token);
-    workers_.erase(it);
-    metrics_.erase(worker);
+  if (it == last) {
+    return;
   }
+  caf::default_attachable::observe_token token{
+      address(), caf::default_attachable::monitor};
+  worker->detach(token);
+  metrics_.erase(metrics_.begin() + (it - workers_.begin()));
+  generations_.erase(generations_.begin() + (it - workers_.begin()));
+  workers_.erase(it);
+  Reindex();
+  auto reports = Report();
+  unique_guard.unlock();
+  Send(reports);
 }
 
 void Router::ClearWorker(Lock &guard) {
@@ -136,12 +575,18 @@ void Router::ClearWorker(Lock &guard) {
   }
   workers_.clear();
   metrics_.clear();
+  generations_.clear();
+  Reindex();
+  auto reports = Report();
+  unique_guard.unlock();
+  Send(reports);
 }
 
 void Router::Exit(Lock &guard, caf::execution_unit *eu,
                   const caf::exit_msg &exit_message) {
   std::vector<caf::actor> workers;
-  std::unordered_map<caf::actor, Metrics> metrics;
+  std::vector<Metrics> metrics;
+  std::unordered_map<caf::actor, size_t> index;
   auto reason = exit_message.reason;
   if (cleanup(std::move(reason), eu)) {
     // send exit messages *always* to all workers and clear vector
@@ -150,6 +595,9 @@ void Router::Exit(Lock &guard, caf::execution_unit *eu,
         guard};
     workers_.swap(workers);
     metrics_.swap(metrics);
+    generations_.clear();
+    index_.swap(index);
+    Reindex();
     unique_guard.unlock();
     const auto message = make_message(exit_message);
     for (const auto &worker : workers) {
@@ -166,18 +614,24 @@ void Router::Down(Lock &guard, caf::execution_unit *eu,
   auto last = workers_.end();
   auto i = std::find(workers_.begin(), workers_.end(), down_message.source);
   CAF_LOG_DEBUG_IF(i == last, "received down message for an unknown worker");
+  Reports reports;
   if (i != last) {
-    metrics_.erase(*i);
+    metrics_.erase(metrics_.begin() + (i - workers_.begin()));
+    generations_.erase(generations_.begin() + (i - workers_.begin()));
     workers_.erase(i);
+    Reindex();
+    reports = Report();
   }
-  if (workers_.empty()) {
+  const auto out_of_workers = workers_.empty();
+  if (out_of_workers) {
     planned_reason_ = caf::exit_reason::out_of_workers;
-    unique_guard.unlock();
-    // we can safely run our cleanup code here without holding
-    // lock_ because abstract_actor has its own lock
-    if (cleanup(planned_reason_, eu)) {
-      unregister_from_system();
-    }
+  }
+  unique_guard.unlock();
+  Send(reports);
+  // we can safely run our cleanup code here without holding
+  // lock_ because abstract_actor has its own lock
+  if (out_of_workers && cleanup(planned_reason_, eu)) {
+    unregister_from_system();
   }
 }
 }  // namespace cdcf::load_balancer
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#ifndef ACTOR_SYSTEM_SRC_LOAD_BALANCER_BATCHER_H_
+#define ACTOR_SYSTEM_SRC_LOAD_BALANCER_BATCHER_H_
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <caf/all.hpp>
+
+namespace cdcf::load_balancer {
+/* Mails waiting to be relayed to the same worker as one batch, buffered by
+ * the worker's generation so a worker removed and added again doesn't pick up
+ * mails batched for it before. */
+class Batcher {
+ public:
+  using Batch = std::vector<caf::mailbox_element_ptr>;
+
+  explicit Batcher(size_t size) : size_(size) {}
+
+  /* buffer `mail` for the worker of `generation` and return the whole batch
+   * once it's full, `first` tells the mail starts a new batch. */
+  Batch Add(uint64_t generation, caf::mailbox_element_ptr &mail, bool &first) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &buffer = buffers_[generation];
+    first = buffer.empty();
+    buffer.push_back(std::move(mail));
+    if (buffer.size() < size_) {
+      return {};
+    }
+    Batch result;
+    result.swap(buffer);
+    return result;
+  }
+
+  Batch Take(uint64_t generation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = buffers_.find(generation);
+    if (it == buffers_.end()) {
+      return {};
+    }
+    auto result = std::move(it->second);
+    buffers_.erase(it);
+    return result;
+  }
+
+ private:
+  size_t size_;
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Batch> buffers_;
+};
+}  // namespace cdcf::load_balancer
+#endif  // ACTOR_SYSTEM_SRC_LOAD_BALANCER_BATCHER_H_
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#ifndef ACTOR_SYSTEM_SRC_LOAD_BALANCER_HEDGER_H_
+#define ACTOR_SYSTEM_SRC_LOAD_BALANCER_HEDGER_H_
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace cdcf::load_balancer {
+/* Lock free histogram, buckets grow exponentially with 4 sub-buckets per
+ * power of two, so a percentile is at most 25% above the exact one. */
+class Histogram {
+ public:
+  /* return count of values recorded so far. */
+  uint64_t Record(uint64_t value) {
+    buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  /* upper bound of the bucket `percentile` falls in, 0 while it's empty. */
+  uint64_t Percentile(double percentile) const {
+    const auto count = count_.load(std::memory_order_relaxed);
+    if (count == 0) {
+      return 0;
+    }
+    const auto rank =
+        std::max<uint64_t>(static_cast<uint64_t>(std::ceil(percentile * count)),
+                           1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return UpperBound(i);
+      }
+    }
+    return UpperBound(buckets_.size() - 1);
+  }
+
+ private:
+  static constexpr size_t kSubBuckets = 4;
+
+  static size_t BucketOf(uint64_t value) {
+    if (value < kSubBuckets) {
+      return value;
+    }
+    size_t octave = HighestBit(value);
+    size_t sub = (value >> (octave - 2)) & (kSubBuckets - 1);
+    return (octave - 1) * kSubBuckets + sub;
+  }
+
+  /* index of the most significant set bit, `value` must not be zero. */
+  static size_t HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+  }
+
+  static uint64_t UpperBound(size_t bucket) {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    size_t octave = bucket / kSubBuckets + 1;
+    size_t sub = bucket % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << (octave - 2)) - 1;
+  }
+
+  std::array<std::atomic<uint64_t>, 64 * kSubBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+};
+
+/* Decides when a request is worth relaying once more: after the given
+ * percentile of round trips seen so far, and only while hedges stay within
+ * the budget, a fraction of requests. */
+class Hedger {
+ public:
+  Hedger(double percentile, double budget)
+      : percentile_(percentile), budget_(budget) {}
+
+  void Record(std::chrono::microseconds latency) {
+    auto count = latencies_.Record(latency.count());
+    /* percentile walks every bucket, refresh the delay now and then. */
+    if (count % kRefreshEvery == 0) {
+      delay_.store(latencies_.Percentile(percentile_),
+                   std::memory_order_relaxed);
+    }
+  }
+
+  /* zero until enough round trips are seen. */
+  std::chrono::microseconds Delay() const {
+    return std::chrono::microseconds(delay_.load(std::memory_order_relaxed));
+  }
+
+  void Relayed() { requests_.fetch_add(1, std::memory_order_relaxed); }
+
+  bool TryHedge() {
+    auto allowed = static_cast<uint64_t>(
+        budget_ * requests_.load(std::memory_order_relaxed));
+    auto hedges = hedges_.load(std::memory_order_relaxed);
+    do {
+      if (hedges >= allowed) {
+        return false;
+      }
+    } while (!hedges_.compare_exchange_weak(hedges, hedges + 1,
+                                            std::memory_order_relaxed));
+    return true;
+  }
+
+ private:
+  static constexpr uint64_t kRefreshEvery = 256;
+
+  double percentile_;
+  double budget_;
+  Histogram latencies_;
+  std::atomic<uint64_t> delay_{0};
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> hedges_{0};
+};
+}  // namespace cdcf::load_balancer
+#endif  // ACTOR_SYSTEM_SRC_LOAD_BALANCER_HEDGER_H_
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#ifndef ACTOR_SYSTEM_SRC_LOAD_BALANCER_LOAD_INDEX_H_
+#define ACTOR_SYSTEM_SRC_LOAD_BALANCER_LOAD_INDEX_H_
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "cdcf/load_balancer/policy.h"
+
+namespace cdcf::load_balancer {
+/* Workers bucketed by load, each bucket is an intrusive circular list so
+ * moving a worker between buckets and picking the least loaded one are O(1).
+ * Buckets only grow up to the highest load ever seen, steady state is free of
+ * allocation. Not thread safe. */
+class LoadIndex {
+ public:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  void Reset(const std::vector<Metrics> &metrics) {
+    const auto size = metrics.size();
+    loads_.resize(size);
+    prev_.resize(size);
+    next_.resize(size);
+    std::fill(heads_.begin(), heads_.end(), npos);
+    min_ = npos;
+    for (size_t i = 0; i < size; ++i) {
+      loads_[i] = metrics[i].load;
+      Link(i);
+    }
+  }
+
+  void Increase(size_t index) {
+    const auto from = loads_[index];
+    Unlink(index);
+    const auto emptied = heads_[from] == npos;
+    ++loads_[index];
+    Link(index);
+    if (from == min_ && emptied) {
+      min_ = from + 1;
+    }
+  }
+
+  void Decrease(size_t index) {
+    if (loads_[index] == 0) {
+      return;
+    }
+    Unlink(index);
+    --loads_[index];
+    Link(index);
+  }
+
+  size_t MinLoad() const { return loads_.empty() ? npos : min_; }
+
+  /* round robin among least loaded workers, return npos if it's empty. */
+  size_t Next() {
+    if (loads_.empty()) {
+      return npos;
+    }
+    auto selected = heads_[min_];
+    heads_[min_] = next_[selected];
+    return selected;
+  }
+
+ private:
+  void Link(size_t index) {
+    const auto load = loads_[index];
+    if (heads_.size() <= load) {
+      heads_.resize(load + 1, npos);
+    }
+    auto head = heads_[load];
+    if (head == npos) {
+      heads_[load] = prev_[index] = next_[index] = index;
+    } else {
+      auto tail = prev_[head];
+      next_[tail] = index;
+      prev_[index] = tail;
+      next_[index] = head;
+      prev_[head] = index;
+    }
+    min_ = std::min(min_, load);
+  }
+
+  void Unlink(size_t index) {
+    const auto load = loads_[index];
+    if (next_[index] == index) {
+      heads_[load] = npos;
+      return;
+    }
+    next_[prev_[index]] = next_[index];
+    prev_[next_[index]] = prev_[index];
+    if (heads_[load] == index) {
+      heads_[load] = next_[index];
+    }
+  }
+
+  std::vector<size_t> loads_;
+  std::vector<size_t> prev_;
+  std::vector<size_t> next_;
+  std::vector<size_t> heads_;
+  size_t min_{npos};
+};
+}  // namespace cdcf::load_balancer
+#endif  // ACTOR_SYSTEM_SRC_LOAD_BALANCER_LOAD_INDEX_H_
@@ -4,64 +4,167 @@
 #include "cdcf/load_balancer/policy.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <limits>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <queue>
+#include <random>
+#include <string>
+
+#include "src/load_balancer/load_index.h"
 
 namespace cdcf::load_balancer::policy {
-class MinLoadImpl {
+/* Workers are spread over shards by index, each with its own load index and
+ * mutex, so selects and load updates of different workers rarely contend.
+ * Every shard publishes its min load, a select scans them without locking and
+ * only locks the least loaded shard. The global mutex is only taken while
+ * mails are held. */
+class MinLoadImpl : public MetricsObserver {
  public:
-  explicit MinLoadImpl(size_t load_threshold_to_hold)
-      : load_threshold_to_hold_(load_threshold_to_hold) {}
-
-  MinLoadImpl(MinLoadImpl &&other) noexcept
-      : rotated_(other.rotated_),
-        mails_(std::move(other.mails_)),
-        load_threshold_to_hold_(other.load_threshold_to_hold_) {}
-
-  MinLoadImpl &operator=(MinLoadImpl &&other) noexcept {
-    rotated_ = other.rotated_;
-    load_threshold_to_hold_ = other.load_threshold_to_hold_;
-    mails_ = std::move(other.mails_);
-    return *this;
-  }
+  MinLoadImpl(size_t load_threshold_to_hold, size_t hold_capacity,
+              Overflow overflow)
+      : load_threshold_to_hold_(load_threshold_to_hold),
+        hold_capacity_(std::max<size_t>(hold_capacity, 1)),
+        overflow_(overflow),
+        shards_(std::make_unique<Shard[]>(kShards)) {}
 
   std::pair<caf::actor, caf::mailbox_element_ptr> operator()(
       const std::vector<caf::actor> &actors,
       const std::vector<Metrics> &metrics, caf::mailbox_element_ptr &mail) {
     assert(actors.size() == metrics.size());
+    /* fast path: nothing is held, only the selected shard is locked. */
+    if (held_ == 0) {
+      if (!mail) {
+        return {};
+      }
+      auto selected = Select();
+      if (selected != LoadIndex::npos) {
+        return {actors[selected], std::move(mail)};
+      }
+    }
+
     std::lock_guard lock{mutex_};
     if (!mail && mails_.empty()) {
       return {};
     }
+    auto selected = Select();
+    if (selected == LoadIndex::npos) {
+      auto shed = HoldOrShed(mail);
+      held_ = mails_.size();
+      if (shed || mails_.empty()) {
+        return {caf::actor{}, std::move(shed)};
+      }
+      /* select again after publishing held mail, a load decreased
+       * concurrently either sees the held mail or is seen here. */
+      selected = Select();
+      if (selected == LoadIndex::npos) {
+        return {};
+      }
+    }
+    Release(mail);
+    held_ = mails_.size();
+    return {actors[selected], std::move(mail)};
+  }
 
-    auto rotated = Rotate(metrics);
-    auto less_load = [](auto &a, auto &b) { return a.load < b.load; };
-    auto selected = std::min_element(rotated.begin(), rotated.end(), less_load);
-    if (selected->load >= load_threshold_to_hold_) {
-      Hold(mail);
-      return {};
+  void Reset(const std::vector<caf::actor> &actors,
+             const std::vector<Metrics> &metrics) override {
+    count_ = std::min(kShards, metrics.size());
+    for (size_t s = 0; s < kShards; ++s) {
+      auto &shard = shards_[s];
+      std::lock_guard lock{shard.mutex};
+      std::vector<Metrics> shard_metrics;
+      for (size_t i = s; i < metrics.size(); i += kShards) {
+        shard_metrics.push_back(metrics[i]);
+      }
+      shard.index.Reset(shard_metrics);
+      shard.min = shard.index.MinLoad();
     }
+  }
 
-    Release(mail);
-    auto offset = selected - rotated.begin();
-    return {actors[(rotated_ + offset) % actors.size()], std::move(mail)};
+  void Increase(size_t index) override {
+    auto &shard = shards_[index % kShards];
+    std::lock_guard lock{shard.mutex};
+    shard.index.Increase(index / kShards);
+    shard.min = shard.index.MinLoad();
   }
 
- private:
-  std::vector<Metrics> Rotate(const std::vector<Metrics> &metrics) {
-    rotated_ = (rotated_ + 1) % metrics.size();
-    std::vector<Metrics> result{metrics.size()};
-    auto pivot = metrics.begin() + rotated_;
-    /* round robin with std::rotated, note its complexity is O(n). */
-    std::rotate_copy(metrics.begin(), pivot, metrics.end(), result.begin());
+  void Decrease(size_t index) override {
+    auto &shard = shards_[index % kShards];
+    std::lock_guard lock{shard.mutex};
+    shard.index.Decrease(index / kShards);
+    shard.min = shard.index.MinLoad();
+  }
+
+  HoldStats Hold() const override {
+    std::lock_guard lock{mutex_};
+    auto result = stats_;
+    result.held = mails_.size();
     return result;
   }
 
-  void Hold(caf::mailbox_element_ptr &mail) {
-    if (mail) {
+ private:
+  static constexpr size_t kShards = 8;
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    LoadIndex index;
+    std::atomic<size_t> min{LoadIndex::npos};
+  };
+
+  /* round robin among least loaded shards, then inside the shard, return
+   * npos if every worker reaches the threshold. */
+  size_t Select() {
+    const auto count = count_;
+    if (count == 0) {
+      return LoadIndex::npos;
+    }
+    auto start = cursor_.fetch_add(1, std::memory_order_relaxed) % count;
+    auto selected = LoadIndex::npos;
+    auto min_load = LoadIndex::npos;
+    for (size_t i = 0; i < count && min_load > 0; ++i) {
+      auto s = (start + i) % count;
+      size_t load = shards_[s].min;
+      if (load < min_load) {
+        min_load = load;
+        selected = s;
+      }
+    }
+    if (min_load >= load_threshold_to_hold_) {
+      return LoadIndex::npos;
+    }
+    auto &shard = shards_[selected];
+    std::lock_guard lock{shard.mutex};
+    /* loaded up since its min was read. */
+    if (shard.index.MinLoad() >= load_threshold_to_hold_) {
+      return LoadIndex::npos;
+    }
+    return shard.index.Next() * kShards + selected;
+  }
+
+  /* return the mail to shed if the queue can't take this one. */
+  caf::mailbox_element_ptr HoldOrShed(caf::mailbox_element_ptr &mail) {
+    if (!mail) {
+      return nullptr;
+    }
+    const auto full = mails_.size() >= hold_capacity_;
+    if (full && overflow_ == Overflow::kDropOldest) {
+      auto oldest = std::move(mails_.front());
+      mails_.pop();
       mails_.emplace(std::move(mail));
+      ++stats_.dropped;
+      return oldest;
+    }
+    closed_ = closed_ || (full && overflow_ == Overflow::kBackpressure);
+    if (full || closed_) {
+      ++stats_.rejected;
+      return std::move(mail);
     }
+    mails_.emplace(std::move(mail));
+    stats_.peak = std::max(stats_.peak, mails_.size());
+    return nullptr;
   }
 
   void Release(caf::mailbox_element_ptr &mail) {
@@ -73,20 +176,321 @@ class MinLoadImpl {
     }
     mail = std::move(mails_.front());
     mails_.pop();
+    if (closed_ && mails_.size() <= hold_capacity_ / 2) {
+      closed_ = false;
+    }
   }
 
-  size_t rotated_{std::numeric_limits<size_t>::max()};
   std::queue<caf::mailbox_element_ptr> mails_;
   size_t load_threshold_to_hold_;
+  size_t hold_capacity_;
+  Overflow overflow_;
+  /* only with kBackpressure, set once the queue is full. */
+  bool closed_{false};
+  HoldStats stats_;
+  mutable std::mutex mutex_;
+  std::atomic<size_t> held_{0};
+  std::atomic<size_t> cursor_{0};
+  /* shards in use, only changes while Router holds the lock exclusively. */
+  size_t count_{0};
+  std::unique_ptr<Shard[]> shards_;
+};
+
+class LocalFirstImpl : public MetricsObserver {
+ public:
+  explicit LocalFirstImpl(size_t load_threshold_to_spill)
+      : load_threshold_to_spill_(load_threshold_to_spill) {}
+
+  std::pair<caf::actor, caf::mailbox_element_ptr> operator()(
+      const std::vector<caf::actor> &actors,
+      const std::vector<Metrics> &metrics, caf::mailbox_element_ptr &mail) {
+    std::lock_guard lock{mutex_};
+    if (!mail) {
+      return {};
+    }
+    auto selected = LoadIndex::npos;
+    if (local_.MinLoad() < load_threshold_to_spill_) {
+      selected = locals_[local_.Next()];
+    } else {
+      selected = all_.Next();
+    }
+    if (selected == LoadIndex::npos) {
+      return {};
+    }
+    return {actors[selected], std::move(mail)};
+  }
+
+  /* a remote worker is a proxy, whose node differs from its home system. */
+  void Reset(const std::vector<caf::actor> &actors,
+             const std::vector<Metrics> &metrics) override {
+    std::lock_guard lock{mutex_};
+    all_.Reset(metrics);
+    locals_.clear();
+    positions_.assign(actors.size(), LoadIndex::npos);
+    std::vector<Metrics> local_metrics;
+    for (size_t i = 0; i < actors.size(); ++i) {
+      if (actors[i].node() == actors[i]->home_system().node()) {
+        positions_[i] = locals_.size();
+        locals_.push_back(i);
+        local_metrics.push_back(metrics[i]);
+      }
+    }
+    local_.Reset(local_metrics);
+  }
+
+  void Increase(size_t index) override {
+    std::lock_guard lock{mutex_};
+    all_.Increase(index);
+    if (positions_[index] != LoadIndex::npos) {
+      local_.Increase(positions_[index]);
+    }
+  }
+
+  void Decrease(size_t index) override {
+    std::lock_guard lock{mutex_};
+    all_.Decrease(index);
+    if (positions_[index] != LoadIndex::npos) {
+      local_.Decrease(positions_[index]);
+    }
+  }
+
+ private:
+  size_t load_threshold_to_spill_;
+  LoadIndex all_;
+  LoadIndex local_;
+  /* index of worker by position in local_, and the other way round. */
+  std::vector<size_t> locals_;
+  std::vector<size_t> positions_;
   std::mutex mutex_;
 };
 
-Policy MinLoad(size_t load_threshold_to_hold) {
-  auto i = std::make_shared<MinLoadImpl>(load_threshold_to_hold);
-  return [i](const std::vector<caf::actor> &actors,
-             const std::vector<Metrics> &metrics,
-             caf::mailbox_element_ptr &mail) mutable {
-    return (*i)(actors, metrics, mail);
+/* Weighted round robin over a schedule built on Reset, where each worker's
+ * turns are spread evenly, so no worker gets a burst. Capacities are reduced
+ * by their gcd and scaled down to at most kMaxSchedule turns. Select is O(1)
+ * and lock free, Reset runs while the router holds its lock exclusively. */
+class WeightedRoundRobinImpl : public MetricsObserver {
+ public:
+  std::pair<caf::actor, caf::mailbox_element_ptr> operator()(
+      const std::vector<caf::actor> &actors,
+      const std::vector<Metrics> &metrics, caf::mailbox_element_ptr &mail) {
+    if (!mail || schedule_.empty()) {
+      return {};
+    }
+    auto turn = cursor_.fetch_add(1, std::memory_order_relaxed);
+    return {actors[schedule_[turn % schedule_.size()]], std::move(mail)};
+  }
+
+  void Reset(const std::vector<caf::actor> &actors,
+             const std::vector<Metrics> &metrics) override {
+    std::vector<uint64_t> weights(metrics.size());
+    std::transform(metrics.begin(), metrics.end(), weights.begin(),
+                   [](auto &metric) {
+                     return static_cast<uint64_t>(
+                         std::max<size_t>(metric.capacity, 1));
+                   });
+    auto divisor = std::accumulate(
+        weights.begin(), weights.end(), uint64_t{0},
+        [](uint64_t x, uint64_t y) { return std::gcd(x, y); });
+    uint64_t total = 0;
+    for (auto &weight : weights) {
+      weight /= divisor;
+      total += weight;
+    }
+    if (total > kMaxSchedule) {
+      for (auto &weight : weights) {
+        weight = std::max<uint64_t>(weight * kMaxSchedule / total, 1);
+      }
+    }
+    /* stride scheduling: the p-th turn of worker i is due at (2p + 1) / 2w,
+     * take the earliest due turn each time. */
+    std::vector<uint64_t> turns(weights.size(), 0);
+    auto later = [&](size_t i, size_t j) {
+      return (2 * turns[i] + 1) * weights[j] > (2 * turns[j] + 1) * weights[i];
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> due(
+        later);
+    for (size_t i = 0; i < weights.size(); ++i) {
+      due.push(i);
+    }
+    schedule_.clear();
+    total = std::accumulate(weights.begin(), weights.end(), uint64_t{0});
+    schedule_.reserve(total);
+    while (schedule_.size() < total) {
+      auto i = due.top();
+      due.pop();
+      schedule_.push_back(i);
+      if (++turns[i] < weights[i]) {
+        due.push(i);
+      }
+    }
+  }
+
+  void Increase(size_t index) override {}
+
+  void Decrease(size_t index) override {}
+
+ private:
+  static constexpr uint64_t kMaxSchedule = 4096;
+
+  std::vector<size_t> schedule_;
+  std::atomic<size_t> cursor_{0};
+};
+
+class ConsistentHashImpl : public MetricsObserver {
+ public:
+  ConsistentHashImpl(KeyOf key_of, size_t virtual_nodes)
+      : key_of_(std::move(key_of)),
+        virtual_nodes_(std::max<size_t>(virtual_nodes, 1)) {}
+
+  std::pair<caf::actor, caf::mailbox_element_ptr> operator()(
+      const std::vector<caf::actor> &actors,
+      const std::vector<Metrics> &metrics, caf::mailbox_element_ptr &mail) {
+    if (!mail || ring_.empty()) {
+      return {};
+    }
+    auto key = Mix(key_of_(mail->content()));
+    auto it = std::lower_bound(
+        ring_.begin(), ring_.end(), key,
+        [](const auto &point, size_t key) { return point.first < key; });
+    if (it == ring_.end()) {
+      it = ring_.begin();
+    }
+    return {actors[it->second], std::move(mail)};
+  }
+
+  /* hash the worker's address rather than its position, so every router
+   * maps a key to the same worker. */
+  void Reset(const std::vector<caf::actor> &actors,
+             const std::vector<Metrics> &metrics) override {
+    ring_.clear();
+    ring_.reserve(actors.size() * virtual_nodes_);
+    std::hash<std::string> hash;
+    for (size_t i = 0; i < actors.size(); ++i) {
+      auto address = caf::to_string(actors[i].address());
+      for (size_t replica = 0; replica < virtual_nodes_; ++replica) {
+        ring_.emplace_back(hash(address + "#" + std::to_string(replica)), i);
+      }
+    }
+    std::sort(ring_.begin(), ring_.end());
+  }
+
+  void Increase(size_t index) override {}
+
+  void Decrease(size_t index) override {}
+
+ private:
+  /* splitmix64 finalizer, keys like small integers are spread over the
+   * ring as evenly as its points are. */
+  static size_t Mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return static_cast<size_t>(key);
+  }
+
+  KeyOf key_of_;
+  size_t virtual_nodes_;
+  std::vector<std::pair<size_t, size_t>> ring_;
+};
+
+Policy MinLoad(size_t load_threshold_to_hold, size_t hold_capacity,
+               Overflow overflow) {
+  auto i = std::make_shared<MinLoadImpl>(load_threshold_to_hold,
+                                         hold_capacity, overflow);
+  return {[i](const std::vector<caf::actor> &actors,
+              const std::vector<Metrics> &metrics,
+              caf::mailbox_element_ptr &mail) mutable {
+            return (*i)(actors, metrics, mail);
+          },
+          i};
+}
+
+Policy PowerOfTwoChoices() {
+  return [](const std::vector<caf::actor> &actors,
+            const std::vector<Metrics> &metrics,
+            caf::mailbox_element_ptr &mail)
+             -> std::pair<caf::actor, caf::mailbox_element_ptr> {
+    const auto size = actors.size();
+    if (!mail || size == 0) {
+      return {};
+    }
+    thread_local std::minstd_rand engine{std::random_device{}()};
+    auto first = engine() % size;
+    auto second =
+        size == 1 ? first : (first + 1 + engine() % (size - 1)) % size;
+    /* compare load / capacity without dividing. */
+    auto cost = [&](size_t i, size_t j) {
+      return metrics[i].load * std::max<size_t>(metrics[j].capacity, 1);
+    };
+    auto selected = cost(second, first) < cost(first, second) ? second : first;
+    return {actors[selected], std::move(mail)};
+  };
+}
+
+Policy MinLatency() {
+  return [](const std::vector<caf::actor> &actors,
+            const std::vector<Metrics> &metrics,
+            caf::mailbox_element_ptr &mail)
+             -> std::pair<caf::actor, caf::mailbox_element_ptr> {
+    const auto size = actors.size();
+    if (!mail || size == 0) {
+      return {};
+    }
+    thread_local std::minstd_rand engine{std::random_device{}()};
+    auto first = engine() % size;
+    auto second =
+        size == 1 ? first : (first + 1 + engine() % (size - 1)) % size;
+    uint64_t first_latency = metrics[first].latency;
+    uint64_t second_latency = metrics[second].latency;
+    /* a worker without any reply yet borrows the other's latency, so it's
+     * compared by load instead of being flooded or starved. */
+    if (first_latency == 0) {
+      first_latency = std::max<uint64_t>(second_latency, 1);
+    }
+    if (second_latency == 0) {
+      second_latency = first_latency;
+    }
+    auto cost = [](const Metrics &metric, uint64_t latency) {
+      return (metric.load + 1) * latency;
+    };
+    auto selected = cost(metrics[second], second_latency) <
+                            cost(metrics[first], first_latency)
+                        ? second
+                        : first;
+    return {actors[selected], std::move(mail)};
   };
 }
+
+Policy LocalFirst(size_t load_threshold_to_spill) {
+  auto i = std::make_shared<LocalFirstImpl>(load_threshold_to_spill);
+  return {[i](const std::vector<caf::actor> &actors,
+              const std::vector<Metrics> &metrics,
+              caf::mailbox_element_ptr &mail) {
+            return (*i)(actors, metrics, mail);
+          },
+          i};
+}
+
+Policy WeightedRoundRobin() {
+  auto i = std::make_shared<WeightedRoundRobinImpl>();
+  return {[i](const std::vector<caf::actor> &actors,
+              const std::vector<Metrics> &metrics,
+              caf::mailbox_element_ptr &mail) {
+            return (*i)(actors, metrics, mail);
+          },
+          i};
+}
+
+Policy ConsistentHash(KeyOf key_of, size_t virtual_nodes) {
+  auto i = std::make_shared<ConsistentHashImpl>(std::move(key_of),
+                                                virtual_nodes);
+  return {[i](const std::vector<caf::actor> &actors,
+              const std::vector<Metrics> &metrics,
+              caf::mailbox_element_ptr &mail) {
+            return (*i)(actors, metrics, mail);
+          },
+          i};
+}
 }  // namespace cdcf::load_balancer::policy
@@ -5,17 +5,22 @@
 #define ACTOR_SYSTEM_SRC_LOAD_BALANCER_PROXY_H_
 #include <cdcf/logger.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <caf/all.hpp>
 
+#include "cdcf/load_balancer/load_balancer.h"
 #include "src/load_balancer/ticket.h"
 
 namespace cdcf::load_balancer {
-using Lock = caf::upgrade_lock<caf::detail::shared_spinlock>;
-
 struct CustomMessageIdEquals {
   bool operator()(const caf::message_id &lhs,
                   const caf::message_id &rhs) const {
@@ -23,70 +28,258 @@ struct CustomMessageIdEquals {
   }
 };
 
+/* Tickets are spread over shards by request id, each with its own mutex, so
+ * concurrent relays and replies rarely contend with each other.
+ *
+ * With a timeout every shard also keeps a hashed timer wheel of response ids
+ * by the tick they expire at. Answered tickets are left in the wheel and
+ * skipped when their slot is swept, so placing and extracting stay O(1). */
 class Proxy {
  public:
-  void Relay(const caf::strong_actor_ptr &sender,
-             caf::mailbox_element_ptr &what, caf::execution_unit *host,
-             Lock &guard, caf::actor worker) {
-    caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> lock{guard};
-    auto new_id = PlaceTicket(what);
-    lock.unlock();
+  using Clock = std::chrono::steady_clock;
+
+  explicit Proxy(size_t shards, std::chrono::milliseconds timeout = {},
+                 bool hedging = false)
+      : hedging_(hedging),
+        timeout_(timeout),
+        resolution_(std::max<Clock::duration>(timeout / kTicksPerTimeout,
+                                              std::chrono::milliseconds{1})) {
+    size_t count = 1;
+    while (count < shards) {
+      count <<= 1;
+    }
+    shard_mask_ = count - 1;
+    shards_ = std::make_unique<Shard[]>(count);
+    if (Expiring()) {
+      for (size_t i = 0; i < count; ++i) {
+        shards_[i].wheel.resize(kWheelSlots);
+      }
+    }
+  }
+
+  /* return id of the request relayed. */
+  caf::message_id Relay(const caf::strong_actor_ptr &sender,
+                        caf::mailbox_element_ptr &what,
+                        caf::execution_unit *host, const caf::actor &worker,
+                        uint64_t generation) {
+    auto ticket = Ticket::ReplyTo(what, worker);
+    ticket.generation = generation;
+    auto content = what->move_content_to_message();
+    if (hedging_ && ticket.response_to) {
+      ticket.content = content;
+    }
+    auto new_id = PlaceTicket(what->mid, std::move(ticket));
     // replace sender with load_balancer
-    worker->enqueue(sender, new_id, what->move_content_to_message(), host);
-    return;
+    worker->enqueue(sender, new_id, std::move(content), host);
+    return new_id;
   }
 
-  void Reply(const caf::strong_actor_ptr &sender,
-             caf::mailbox_element_ptr &what, caf::execution_unit *host,
-             Lock &guard, const std::vector<caf::actor> &workers) {
-    caf::upgrade_to_unique_lock<caf::detail::shared_spinlock> lock{guard};
-    auto ticket = ExtractTicket(what, workers);
-    lock.unlock();
-    ticket.Reply(sender, what->move_content_to_message(), host);
+  /* relay mails as one (batch_atom, message of their contents). */
+  void RelayBatch(const caf::strong_actor_ptr &sender,
+                  std::vector<caf::mailbox_element_ptr> &batch,
+                  caf::execution_unit *host, const caf::actor &worker,
+                  uint64_t generation) {
+    Ticket ticket{{}, {}, worker, Clock::now()};
+    ticket.generation = generation;
+    caf::message_builder contents;
+    for (auto &mail : batch) {
+      ticket.batched.push_back(Ticket::ReplyTo(mail, worker));
+      contents.append(mail->move_content_to_message());
+    }
+    auto new_id = PlaceTicket(batch.front()->mid, std::move(ticket));
+    worker->enqueue(sender, new_id,
+                    caf::make_message(batch_atom::value,
+                                      contents.move_to_message()),
+                    host);
   }
 
- private:
-  caf::message_id PlaceTicket(caf::mailbox_element_ptr &what) {
-    auto new_message_id = AllocateRequestID(what);
-    auto ticket = Ticket::ReplyTo(what);
-    std::lock_guard<std::mutex> lock(ticket_mutex_);
-    tickets_.emplace(new_message_id.response_id(), ticket);
-    return new_message_id;
+  Ticket ExtractTicket(const caf::mailbox_element_ptr &what) {
+    return ExtractTicket(what->mid);
   }
 
-  Ticket ExtractTicket(caf::mailbox_element_ptr &what,
-                       const std::vector<caf::actor> &workers) {
-    std::lock_guard<std::mutex> lock(ticket_mutex_);
-    auto it = tickets_.find(what->mid);
-    if (it == tickets_.end()) {
+  Ticket ExtractTicket(const caf::message_id &response_id) {
+    auto &shard = ShardOf(response_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.tickets.find(response_id);
+    if (it == shard.tickets.end()) {
       return {};
     }
-    /* worker get remove from load balancer, should remove the ticket */
-    if (std::find(workers.begin(), workers.end(), what->sender) ==
-        workers.end()) {
-      tickets_.erase(it);
+    auto result = std::move(it->second);
+    shard.tickets.erase(it);
+    ++shard.counters.extracted;
+    return result;
+  }
+
+  /* worker of a request still waiting for its reply and not hedged yet. */
+  caf::actor HedgeableWorker(const caf::message_id &response_id) {
+    auto &shard = ShardOf(response_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.tickets.find(response_id);
+    if (it == shard.tickets.end() || it->second.answered ||
+        it->second.content.empty()) {
       return {};
     }
-    auto result = it->second;
-    tickets_.erase(it);
+    return it->second.worker;
+  }
+
+  /* relay a pending request once more to `worker`, return false if it's
+   * answered or hedged meanwhile. */
+  bool Hedge(const caf::strong_actor_ptr &sender,
+             const caf::message_id &response_id, caf::execution_unit *host,
+             const caf::actor &worker, uint64_t generation) {
+    auto priority = static_cast<caf::message_priority>(response_id.category());
+    auto new_id = AllocateRequestID(priority);
+    Ticket twin;
+    caf::message content;
+    {
+      auto &shard = ShardOf(response_id);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.tickets.find(response_id);
+      if (it == shard.tickets.end() || it->second.answered) {
+        return false;
+      }
+      auto &ticket = it->second;
+      ticket.answered = std::make_shared<std::atomic<bool>>(false);
+      ticket.sibling = new_id.response_id();
+      content = std::move(ticket.content);
+      twin = Ticket{ticket.response_id, ticket.response_to, worker,
+                    Clock::now()};
+      twin.generation = generation;
+      twin.answered = ticket.answered;
+      twin.sibling = response_id;
+    }
+    InsertTicket(new_id.response_id(), std::move(twin));
+    worker->enqueue(sender, new_id, std::move(content), host);
+    return true;
+  }
+
+  /* remove and return tickets past their deadline. */
+  std::vector<Ticket> ExpireTickets(Clock::time_point now) {
+    std::vector<Ticket> result;
+    if (!Expiring()) {
+      return result;
+    }
+    const auto now_tick = TickOf(now);
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+      auto &shard = shards_[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      /* a whole turn covers every slot. */
+      auto from = now_tick - std::min(now_tick, kWheelSlots - 1);
+      from = std::max(from, shard.swept + 1);
+      for (auto tick = from; tick <= now_tick; ++tick) {
+        auto &slot = shard.wheel[tick & (kWheelSlots - 1)];
+        auto kept = std::remove_if(slot.begin(), slot.end(), [&](auto &entry) {
+          if (entry.first > now_tick) {
+            return false;
+          }
+          auto it = shard.tickets.find(entry.second);
+          if (it != shard.tickets.end()) {
+            result.push_back(std::move(it->second));
+            shard.tickets.erase(it);
+            ++shard.counters.expired;
+          }
+          return true;
+        });
+        slot.erase(kept, slot.end());
+      }
+      shard.swept = std::max(shard.swept, now_tick);
+    }
+    return result;
+  }
+
+  bool Expiring() const { return timeout_.count() > 0; }
+
+  /* tickets counted under their shard's lock, a batch counts once. */
+  struct Counters {
+    uint64_t placed{0};
+    uint64_t extracted{0};
+    uint64_t expired{0};
+    size_t pending{0};
+  };
+
+  Counters Count() const {
+    Counters result;
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+      auto &shard = shards_[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      result.placed += shard.counters.placed;
+      result.extracted += shard.counters.extracted;
+      result.expired += shard.counters.expired;
+      result.pending += shard.tickets.size();
+    }
     return result;
   }
 
-  caf::message_id AllocateRequestID(caf::mailbox_element_ptr &what) {
-    auto priority = static_cast<caf::message_priority>(what->mid.category());
-    auto result = ++last_request_id_;
+  size_t Pending() const { return Count().pending; }
+
+  /* sweeping more often than this finds nothing new. */
+  Clock::duration Resolution() const { return resolution_; }
+
+ private:
+  using Tickets =
+      std::unordered_map<caf::message_id, Ticket, std::hash<caf::message_id>,
+                         CustomMessageIdEquals>;
+
+  /* a ticket expires within [timeout, timeout + timeout / kTicksPerTimeout],
+   * the wheel spans twice as many ticks so one turn is always sorted out by
+   * the next sweep. */
+  static constexpr uint64_t kTicksPerTimeout = 8;
+  static constexpr uint64_t kWheelSlots = 2 * kTicksPerTimeout;
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    Tickets tickets;
+    /* (tick to expire at, response id) slotted by tick. */
+    std::vector<std::vector<std::pair<uint64_t, caf::message_id>>> wheel;
+    uint64_t swept{0};
+    Counters counters;
+  };
+
+  caf::message_id PlaceTicket(const caf::message_id &original, Ticket ticket) {
+    auto priority = static_cast<caf::message_priority>(original.category());
+    auto new_message_id = AllocateRequestID(priority);
+    InsertTicket(new_message_id.response_id(), std::move(ticket));
+    return new_message_id;
+  }
+
+  void InsertTicket(const caf::message_id &response_id, Ticket ticket) {
+    auto &shard = ShardOf(response_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.counters.placed;
+    if (Expiring()) {
+      auto deadline = TickOf(ticket.relayed_at + timeout_) + 1;
+      shard.wheel[deadline & (kWheelSlots - 1)].emplace_back(deadline,
+                                                             response_id);
+    }
+    shard.tickets.emplace(response_id, std::move(ticket));
+  }
+
+  uint64_t TickOf(Clock::time_point time) const {
+    return time.time_since_epoch() / resolution_;
+  }
+
+  caf::message_id AllocateRequestID(caf::message_priority priority) {
+    static const auto first = caf::make_message_id().integer_value();
+    auto result = caf::make_message_id(
+        first + last_request_id_.fetch_add(1, std::memory_order_relaxed) + 1);
     CDCF_LOGGER_DEBUG("current request id: {}", result.integer_value());
     return priority == caf::message_priority::normal
                ? result
                : result.with_high_priority();
   }
 
+  /* request and response id only differ in flag bits, low bits are shared. */
+  Shard &ShardOf(const caf::message_id &id) {
+    return shards_[id.integer_value() & shard_mask_];
+  }
+
  private:
-  caf::message_id last_request_id_ = {caf::make_message_id()};
-  std::unordered_map<caf::message_id, Ticket, std::hash<caf::message_id>,
-                     CustomMessageIdEquals>
-      tickets_;
-  std::mutex ticket_mutex_;
+  std::atomic<uint64_t> last_request_id_{0};
+  bool hedging_;
+  std::chrono::milliseconds timeout_;
+  Clock::duration resolution_;
+  size_t shard_mask_;
+  std::unique_ptr<Shard[]> shards_;
 };
 }  // namespace cdcf::load_balancer
 #endif  // ACTOR_SYSTEM_SRC_LOAD_BALANCER_PROXY_H_
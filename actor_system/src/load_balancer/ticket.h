@@ -3,25 +3,54 @@
  */
 #ifndef ACTOR_SYSTEM_SRC_LOAD_BALANCER_TICKET_H_
 #define ACTOR_SYSTEM_SRC_LOAD_BALANCER_TICKET_H_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <caf/all.hpp>
 
 namespace cdcf::load_balancer {
 struct Ticket {
-  static Ticket ReplyTo(caf::mailbox_element_ptr &what) {
+  static Ticket ReplyTo(caf::mailbox_element_ptr &what,
+                        const caf::actor &worker) {
     bool required_reply = what->mid != what->mid.response_id();
-    return required_reply ? Ticket{what->mid.response_id(),
-                                   caf::actor_cast<caf::actor>(what->sender)}
-                          : Ticket{};
+    auto now = std::chrono::steady_clock::now();
+    return required_reply
+               ? Ticket{what->mid.response_id(),
+                        caf::actor_cast<caf::actor>(what->sender), worker, now}
+               : Ticket{{}, {}, worker, now};
   }
 
   caf::message_id response_id;
   caf::actor response_to;
+  /* worker the request is relayed to, whose load is released on reply. */
+  caf::actor worker;
+  std::chrono::steady_clock::time_point relayed_at;
+  /* generation of `worker` when relayed, a worker removed and added again
+   * starts a new one, so replies from before don't release its new load. */
+  uint64_t generation{0};
+  /* tickets of the requests relayed together as one batch, if any. */
+  std::vector<Ticket> batched;
+  /* content of the request, only kept while hedging to relay it again. */
+  caf::message content;
+  /* shared by both tickets of a hedged request, the first to reply wins and
+   * cancels its sibling. */
+  std::shared_ptr<std::atomic<bool>> answered;
+  caf::message_id sibling;
+
+  size_t Requests() const { return batched.empty() ? 1 : batched.size(); }
 
+  /* a batch ticket replies `message` to every request in it. */
   void Reply(caf::strong_actor_ptr sender, const caf::message &message,
              caf::execution_unit *host) const {
     if (response_to) {
       response_to->enqueue(sender, response_id, message, host);
     }
+    for (const auto &ticket : batched) {
+      ticket.Reply(sender, message, host);
+    }
   }
 };
 }  // namespace cdcf::load_balancer
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#include <benchmark/benchmark.h>
+#include <cdcf/load_balancer/load_balancer.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+caf::behavior Echo() {
+  return {[](size_t x) { return x; }};
+}
+
+/* One actor system shared by every benchmark, routers are built once per
+ * policy and worker count, so benchmark threads all hit the same router. */
+class Environment {
+ public:
+  static Environment& Instance() {
+    static Environment instance;
+    return instance;
+  }
+
+  ~Environment() {
+    for (const auto& [key, router] : routers_) {
+      caf::anon_send_exit(router, caf::exit_reason::user_shutdown);
+    }
+  }
+
+  caf::actor Router(const std::string& name,
+                    const std::function<cdcf::load_balancer::Policy()>& policy,
+                    size_t workers) {
+    std::lock_guard lock{mutex_};
+    auto& router = routers_[{name, workers}];
+    if (!router) {
+      router = cdcf::load_balancer::Router::Make(&context_, policy());
+      for (size_t i = 0; i < workers; ++i) {
+        caf::anon_send(router, caf::sys_atom::value, caf::put_atom::value,
+                       system_.spawn(Echo));
+      }
+    }
+    return router;
+  }
+
+  caf::actor_system& System() { return system_; }
+
+ private:
+  caf::actor_system_config config_;
+  caf::actor_system system_{config_};
+  caf::scoped_execution_unit context_{&system_};
+  std::mutex mutex_;
+  std::map<std::pair<std::string, size_t>, caf::actor> routers_;
+};
+
+cdcf::load_balancer::Policy MinLoad() {
+  return cdcf::load_balancer::policy::MinLoad();
+}
+
+cdcf::load_balancer::Policy PowerOfTwoChoices() {
+  return cdcf::load_balancer::policy::PowerOfTwoChoices();
+}
+
+/* one request at a time per thread, measures routing latency. */
+void RoundTrip(benchmark::State& state, const std::string& name,
+               cdcf::load_balancer::Policy (*policy)()) {
+  auto& environment = Environment::Instance();
+  auto router = environment.Router(name, policy, state.range(0));
+  caf::scoped_actor self{environment.System()};
+  for (auto _ : state) {
+    self->request(router, caf::infinite, size_t{1})
+        .receive([](size_t) {},
+                 [&](caf::error&) { state.SkipWithError("request failed"); });
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/* `kBurst` requests in flight per thread, measures routing throughput. */
+void Burst(benchmark::State& state, const std::string& name,
+           cdcf::load_balancer::Policy (*policy)()) {
+  constexpr size_t kBurst = 256;
+  auto& environment = Environment::Instance();
+  auto router = environment.Router(name, policy, state.range(0));
+  caf::scoped_actor self{environment.System()};
+  std::vector<decltype(self->request(router, caf::infinite, size_t{1}))>
+      handles;
+  handles.reserve(kBurst);
+  for (auto _ : state) {
+    handles.clear();
+    for (size_t i = 0; i < kBurst; ++i) {
+      handles.push_back(self->request(router, caf::infinite, size_t{1}));
+    }
+    for (auto& handle : handles) {
+      handle.receive([](size_t) {}, [&](caf::error&) {
+        state.SkipWithError("request failed");
+      });
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+void Workers(benchmark::internal::Benchmark* benchmark) {
+  for (auto workers : {1, 4, 16, 64}) {
+    benchmark->Arg(workers);
+  }
+}
+}  // namespace
+
+BENCHMARK_CAPTURE(RoundTrip, min_load, "min_load", MinLoad)
+    ->Apply(Workers)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(RoundTrip, power_of_two_choices, "power_of_two_choices",
+                  PowerOfTwoChoices)
+    ->Apply(Workers)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(Burst, min_load, "min_load", MinLoad)
+    ->Apply(Workers)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(Burst, power_of_two_choices, "power_of_two_choices",
+                  PowerOfTwoChoices)
+    ->Apply(Workers)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -6,10 +6,12 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <future>
 #include <iterator>
+#include <thread>
 
 using testing::Eq, testing::NotNull;
 
@@ -47,6 +49,33 @@ caf::behavior adder(Worker* self) {
           [=](lock_atom) { self->state.Lock(); }};
 }
 
+caf::behavior batch_adder(Worker* self) {
+  return cdcf::load_balancer::AcceptBatch(
+      [=](factorial_atom, size_t x) {
+        ++self->state.count;
+        size_t result = 1;
+        for (size_t i = 1; i <= x; ++i) {
+          result *= i;
+        }
+        return result;
+      },
+      [=](count_atom) -> size_t { return self->state.count; });
+}
+
+caf::behavior key_owner(Worker* self) {
+  return {[=](factorial_atom, size_t x) { return self->id(); },
+          [=](count_atom) -> size_t { return self->state.count; }};
+}
+
+caf::behavior slow_adder(Worker* self) {
+  return {[=](factorial_atom, size_t x) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ++self->state.count;
+            return x;
+          },
+          [=](count_atom) -> size_t { return self->state.count; }};
+}
+
 MATCHER_P(ExecutedTimes, times,
           "actor executed " + std::to_string(times) + " time(s)") {
   auto func = caf::make_function_view(arg);
@@ -93,6 +122,17 @@ class LoadBalancerTest : public ::testing::Test {
     }
   }
 
+  void Prepare(cdcf::load_balancer::Policy policy,
+               const std::vector<size_t>& capacities) {
+    balancer_ = cdcf::load_balancer::Router::Make(&context, std::move(policy));
+    for (auto capacity : capacities) {
+      auto worker = system_.spawn(adder);
+      workers_.push_back(worker);
+      caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                     worker, capacity);
+    }
+  }
+
   void TearDown() override {
     if (should_cleanup_) {
       for (const auto& actor : workers_) {
@@ -138,6 +178,18 @@ TEST_F(LoadBalancerTest, should_route_evenly_with_function_view) {
   EXPECT_THAT(workers_[1], ExecutedTimes(1));
 }
 
+TEST_F(LoadBalancerTest, should_route_evenly_over_more_workers_than_shards) {
+  Prepare(10);
+
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{2});
+  }
+
+  for (const auto& worker : workers_) {
+    EXPECT_THAT(worker, ExecutedTimes(1));
+  }
+}
+
 TEST_F(LoadBalancerTest, should_route_evenly_with_request_receive) {
   Prepare(2);
 
@@ -215,6 +267,50 @@ TEST_F(LoadBalancerTest, should_route_to_first_worker_while_all_are_busy) {
   EXPECT_THAT(workers_[0], ExecutedTimes(1));
 }
 
+TEST_F(LoadBalancerTest, should_relay_reply_of_worker_removed_meanwhile) {
+  Prepare(2);
+  auto replied = std::async(std::launch::async, [&] {
+    caf::scoped_actor self{system_};
+    auto result = false;
+    self->request(balancer_, caf::infinite, lock_atom::value)
+        .receive([&]() { result = true; }, [&](caf::error&) {});
+    return result;
+  });
+  caf::actor_cast<Worker*>(workers_[0])->state.WaitForLocked();
+
+  caf::anon_send(balancer_, caf::sys_atom::value, caf::delete_atom::value,
+                 workers_[0]);
+  caf::actor_cast<Worker*>(workers_[0])->state.Unlock();
+
+  EXPECT_TRUE(replied.get());
+}
+
+TEST_F(LoadBalancerTest, should_not_release_load_of_worker_added_again) {
+  Prepare(2);
+  auto replied = std::async(std::launch::async, [&] {
+    caf::scoped_actor self{system_};
+    auto result = false;
+    self->request(balancer_, caf::infinite, lock_atom::value)
+        .receive([&]() { result = true; }, [&](caf::error&) {});
+    return result;
+  });
+  caf::actor_cast<Worker*>(workers_[0])->state.WaitForLocked();
+
+  caf::anon_send(balancer_, caf::sys_atom::value, caf::delete_atom::value,
+                 workers_[0]);
+  caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                 workers_[0]);
+  caf::actor_cast<Worker*>(workers_[0])->state.Unlock();
+  ASSERT_TRUE(replied.get());
+
+  auto message = make_function_view(balancer_)(
+      caf::sys_atom::value, caf::get_atom::value,
+      cdcf::load_balancer::stats_atom::value);
+  auto stats = message->get_as<cdcf::load_balancer::Stats>(0);
+  EXPECT_THAT(stats.workers, testing::ElementsAre(workers_[1], workers_[0]));
+  EXPECT_THAT(stats.loads, testing::ElementsAre(0, 0));
+}
+
 TEST_F(LoadBalancerTest, should_exit_workers_while_send_exit_to_balancer) {
   Prepare(4);
   const auto reason = caf::exit_reason::remote_link_unreachable;
@@ -251,3 +347,297 @@ TEST_F(LoadBalancerTest, should_roughly_route_even_under_throughput_load) {
   EXPECT_THAT(workers_, AllExecutedTimesNear(times / concurrent,
                                              load_threshold * concurrent));
 }
+
+TEST_F(LoadBalancerTest, should_answer_all_requests_from_concurrent_clients) {
+  constexpr size_t clients = 8;
+  constexpr size_t times = 100;
+  Prepare(4);
+
+  auto client = [=](caf::event_based_actor* self, caf::actor balancer) {
+    for (size_t i = 0; i < times; ++i) {
+      self->request(balancer, caf::infinite, factorial_atom::value, size_t{2})
+          .then([](size_t) {});
+    }
+  };
+  caf::scoped_actor self{system_};
+  std::vector<caf::actor> actors;
+  for (size_t i = 0; i < clients; ++i) {
+    actors.emplace_back(self->spawn(client, balancer_));
+  }
+  self->wait_for(actors);
+
+  // every worker within half of its fair share either way
+  const auto share = clients * times / workers_.size();
+  EXPECT_THAT(workers_, AllExecutedTimesNear(share, share / 2));
+}
+
+TEST_F(LoadBalancerTest, should_route_by_capacity_with_weighted_round_robin) {
+  Prepare(cdcf::load_balancer::policy::WeightedRoundRobin(), {1, 3});
+
+  for (size_t i = 0; i < 8; ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{2});
+  }
+
+  EXPECT_THAT(workers_[0], ExecutedTimes(2));
+  EXPECT_THAT(workers_[1], ExecutedTimes(6));
+}
+
+TEST_F(LoadBalancerTest, should_route_same_key_to_same_worker) {
+  auto key_of = [](const caf::type_erased_tuple& content) {
+    return content.match_elements<factorial_atom, size_t>()
+               ? content.get_as<size_t>(1)
+               : size_t{0};
+  };
+  Prepare(cdcf::load_balancer::policy::ConsistentHash(key_of), {1, 1, 1, 1});
+
+  for (size_t i = 0; i < 4; ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{5});
+  }
+
+  auto executed = std::count_if(workers_.begin(), workers_.end(),
+                                [](auto& worker) {
+                                  auto func = make_function_view(worker);
+                                  auto message = *func(count_atom::value);
+                                  return message.get_as<size_t>(0) > 0;
+                                });
+  EXPECT_THAT(executed, Eq(1));
+}
+
+TEST_F(LoadBalancerTest, should_spread_keys_and_move_only_keys_of_left_worker) {
+  constexpr size_t keys = 256;
+  auto key_of = [](const caf::type_erased_tuple& content) {
+    return content.match_elements<factorial_atom, size_t>()
+               ? content.get_as<size_t>(1)
+               : size_t{0};
+  };
+  balancer_ = cdcf::load_balancer::Router::Make(
+      &context, cdcf::load_balancer::policy::ConsistentHash(key_of));
+  caf::scoped_actor self{system_};
+  for (size_t i = 0; i < 4; ++i) {
+    workers_.push_back(system_.spawn(key_owner));
+    self->send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+               workers_.back());
+  }
+  auto owners = [&] {
+    std::vector<caf::actor_id> result;
+    for (size_t key = 0; key < keys; ++key) {
+      self->request(balancer_, caf::infinite, factorial_atom::value, key)
+          .receive([&](caf::actor_id owner) { result.push_back(owner); },
+                   [&](caf::error&) { result.push_back(0); });
+    }
+    return result;
+  };
+
+  auto before = owners();
+  std::vector<size_t> owned(workers_.size());
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    owned[i] = std::count(before.begin(), before.end(), workers_[i].id());
+  }
+  const auto left = workers_[1];
+  self->send(balancer_, caf::sys_atom::value, caf::delete_atom::value, left);
+  auto after = owners();
+
+  // every worker owns some keys, not one worker all of them
+  EXPECT_THAT(owned, testing::Each(testing::Gt(keys / 16)));
+  for (size_t key = 0; key < keys; ++key) {
+    if (before[key] == left.id()) {
+      EXPECT_THAT(after[key], testing::Ne(left.id()));
+    } else {
+      EXPECT_THAT(after[key], Eq(before[key]));
+    }
+  }
+}
+
+TEST_F(LoadBalancerTest, should_answer_all_requests_with_power_of_two_choices) {
+  constexpr size_t times = 400;
+  Prepare(cdcf::load_balancer::policy::PowerOfTwoChoices(), {1, 1, 1, 1});
+
+  auto async = [=](caf::event_based_actor* self, caf::actor balancer) {
+    for (size_t i = 0; i < times; ++i) {
+      self->request(balancer, caf::infinite, factorial_atom::value, size_t{2})
+          .then([](size_t) {});
+    }
+  };
+  caf::scoped_actor self{system_};
+  auto actor = self->spawn(async, balancer_);
+  self->wait_for(actor);
+
+  // every worker within half of its fair share either way
+  const auto share = times / workers_.size();
+  EXPECT_THAT(workers_, AllExecutedTimesNear(share, share / 2));
+}
+
+TEST_F(LoadBalancerTest, should_avoid_slow_worker_with_min_latency) {
+  balancer_ = cdcf::load_balancer::Router::Make(
+      &context, cdcf::load_balancer::policy::MinLatency());
+  auto slow = system_.spawn(slow_adder);
+  auto fast = system_.spawn(adder);
+  workers_.push_back(fast);
+  for (const auto& worker : {slow, fast}) {
+    caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                   worker);
+  }
+
+  for (size_t i = 0; i < 20; ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{2});
+  }
+
+  auto func = make_function_view(slow);
+  auto message = *func(count_atom::value);
+  EXPECT_THAT(message.get_as<size_t>(0), testing::Le(2));
+}
+
+TEST_F(LoadBalancerTest, should_reject_request_while_hold_queue_is_full) {
+  using cdcf::load_balancer::policy::Overflow;
+  auto policy = cdcf::load_balancer::policy::MinLoad(1, 1, Overflow::kReject);
+  Prepare(policy, {1});
+  caf::anon_send(balancer_, lock_atom::value);
+  caf::actor_cast<Worker*>(workers_[0])->state.WaitForLocked();
+  caf::anon_send(balancer_, factorial_atom::value, size_t{2});
+
+  caf::scoped_actor self{system_};
+  caf::error error;
+  self->request(balancer_, caf::infinite, factorial_atom::value, size_t{2})
+      .receive([](size_t) {}, [&](caf::error& e) { error = e; });
+
+  EXPECT_THAT(error, Eq(cdcf::load_balancer::make_error(
+                         cdcf::load_balancer::load_balancer_error::overloaded)));
+  EXPECT_THAT(policy.Observer()->Hold().held, Eq(1));
+  EXPECT_THAT(policy.Observer()->Hold().rejected, Eq(1));
+}
+
+TEST_F(LoadBalancerTest, should_drop_oldest_request_while_hold_queue_is_full) {
+  using cdcf::load_balancer::policy::Overflow;
+  auto policy =
+      cdcf::load_balancer::policy::MinLoad(1, 1, Overflow::kDropOldest);
+  Prepare(policy, {1});
+  caf::anon_send(balancer_, lock_atom::value);
+  caf::actor_cast<Worker*>(workers_[0])->state.WaitForLocked();
+
+  caf::scoped_actor self{system_};
+  caf::error error;
+  auto oldest =
+      self->request(balancer_, caf::infinite, factorial_atom::value, size_t{2});
+  caf::anon_send(balancer_, factorial_atom::value, size_t{2});
+  oldest.receive([](size_t) {}, [&](caf::error& e) { error = e; });
+
+  EXPECT_THAT(error, Eq(cdcf::load_balancer::make_error(
+                         cdcf::load_balancer::load_balancer_error::overloaded)));
+  EXPECT_THAT(policy.Observer()->Hold().dropped, Eq(1));
+}
+
+TEST_F(LoadBalancerTest, should_answer_timeout_while_worker_never_replies) {
+  cdcf::load_balancer::Options options;
+  options.ticket_timeout = std::chrono::milliseconds{50};
+  balancer_ = cdcf::load_balancer::Router::Make(
+      &context, cdcf::load_balancer::policy::MinLoad(), options);
+  workers_.push_back(system_.spawn(adder));
+  caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                 workers_[0]);
+
+  caf::scoped_actor self{system_};
+  caf::error error;
+  self->request(balancer_, caf::infinite, lock_atom::value)
+      .receive([]() {}, [&](caf::error& e) { error = e; });
+
+  EXPECT_THAT(error, Eq(caf::make_error(caf::sec::request_timeout)));
+}
+
+TEST_F(LoadBalancerTest, should_fan_out_replies_of_batched_requests) {
+  constexpr size_t times = 8;
+  cdcf::load_balancer::Options options;
+  options.batch_size = 4;
+  options.batch_delay = std::chrono::milliseconds{10};
+  balancer_ = cdcf::load_balancer::Router::Make(
+      &context, cdcf::load_balancer::policy::MinLoad(times), options);
+  workers_.push_back(system_.spawn(batch_adder));
+  caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                 workers_[0]);
+
+  std::atomic<size_t> sum{0};
+  auto async = [&](caf::event_based_actor* self, caf::actor balancer) {
+    for (size_t i = 0; i < times; ++i) {
+      self->request(balancer, caf::infinite, factorial_atom::value, i % 4)
+          .then([&](size_t result) { sum += result; });
+    }
+  };
+  caf::scoped_actor self{system_};
+  auto actor = self->spawn(async, balancer_);
+  self->wait_for(actor);
+
+  EXPECT_THAT(sum.load(), Eq(2 * (1 + 1 + 2 + 6)));
+  EXPECT_THAT(workers_[0], ExecutedTimes(times));
+}
+
+TEST_F(LoadBalancerTest, should_hedge_request_stuck_on_busy_worker) {
+  auto first = [](const std::vector<caf::actor>& actors,
+                  const std::vector<cdcf::load_balancer::Metrics>& metrics,
+                  caf::mailbox_element_ptr& mail)
+      -> std::pair<caf::actor, caf::mailbox_element_ptr> {
+    return {actors.front(), std::move(mail)};
+  };
+  cdcf::load_balancer::Options options;
+  options.hedge_percentile = 0.5;
+  options.hedge_budget = 1;
+  balancer_ = cdcf::load_balancer::Router::Make(&context, first, options);
+  std::generate_n(std::back_inserter(workers_), 2,
+                  [&]() { return system_.spawn(adder); });
+  for (const auto& worker : workers_) {
+    caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
+                   worker);
+  }
+  for (size_t i = 0; i < 300; ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{2});
+  }
+  caf::anon_send(balancer_, lock_atom::value);
+  caf::actor_cast<Worker*>(workers_[0])->state.WaitForLocked();
+
+  auto message =
+      make_function_view(balancer_)(factorial_atom::value, size_t{3});
+
+  EXPECT_THAT(message->get_as<size_t>(0), Eq(6));
+  EXPECT_THAT(workers_[1], ExecutedTimes(1));
+}
+
+TEST_F(LoadBalancerTest, should_balance_between_node_routers_by_capacity) {
+  auto make_node = [&](size_t count) {
+    auto node = cdcf::load_balancer::Router::Make(
+        &context, cdcf::load_balancer::policy::MinLoad());
+    for (size_t i = 0; i < count; ++i) {
+      auto worker = system_.spawn(adder);
+      workers_.push_back(worker);
+      caf::anon_send(node, caf::sys_atom::value, caf::put_atom::value, worker);
+    }
+    return node;
+  };
+  auto small = make_node(1);
+  auto large = make_node(3);
+  balancer_ = cdcf::load_balancer::Router::Make(
+      &context, cdcf::load_balancer::policy::WeightedRoundRobin());
+  for (const auto& node : {small, large}) {
+    caf::anon_send(node, caf::sys_atom::value, caf::join_atom::value,
+                   balancer_);
+  }
+
+  for (size_t i = 0; i < 8; ++i) {
+    make_function_view(balancer_)(factorial_atom::value, size_t{2});
+  }
+
+  EXPECT_THAT(workers_[0], ExecutedTimes(2));
+}
+
+TEST_F(LoadBalancerTest, should_report_stats) {
+  Prepare(2);
+  make_function_view(balancer_)(factorial_atom::value, size_t{2});
+
+  auto message = make_function_view(balancer_)(
+      caf::sys_atom::value, caf::get_atom::value,
+      cdcf::load_balancer::stats_atom::value);
+
+  auto stats = message->get_as<cdcf::load_balancer::Stats>(0);
+  EXPECT_THAT(stats.relayed, Eq(1));
+  EXPECT_THAT(stats.replied, Eq(1));
+  EXPECT_THAT(stats.pending, Eq(0));
+  EXPECT_THAT(stats.workers, Eq(workers_));
+  EXPECT_THAT(stats.loads, testing::ElementsAre(0, 0));
+}
@@ -7,33 +7,41 @@ namespace cdcf {
 
 void MessagePriorityActor::enqueue(caf::mailbox_element_ptr ptr,
                                    caf::execution_unit* eu) {
-  auto message = ptr->copy_content_to_message();
-  auto message_id = ptr->mid;
+  // classify in place, mails without priority atom are enqueued untouched
+  const auto& content = ptr->content();
+  auto high = IsFirstElementHighPriorityAtom(content);
+  if (!high && !IsFirstElementNormalPriorityAtom(content)) {
+    scheduled_actor::enqueue(std::move(ptr), eu);
+    return;
+  }
 
-  if (IsFirstElementHighPriorityAtom(message)) {
-    DeleteFirstElement(message);
+  auto message_id = ptr->mid;
+  if (high) {
     AddMessageIdWithHighPriority(message_id);
-    auto element =
-        make_mailbox_element(ptr->sender, message_id, ptr->stages, message);
-    scheduled_actor::enqueue(std::move(element), eu);
-  } else if (IsFirstElementNormalPriorityAtom(message)) {
-    DeleteFirstElement(message);
-    auto element =
-        make_mailbox_element(ptr->sender, message_id, ptr->stages, message);
-    scheduled_actor::enqueue(std::move(element), eu);
-  } else {
-    scheduled_actor::enqueue(std::move(ptr), eu);
   }
+  // payload is moved, not copied, and the atom dropped by a view on it
+  auto message = ptr->move_content_to_message();
+  DeleteFirstElement(message);
+  auto element = make_mailbox_element(std::move(ptr->sender), message_id,
+                                      std::move(ptr->stages),
+                                      std::move(message));
+  scheduled_actor::enqueue(std::move(element), eu);
 }
 
 bool MessagePriorityActor::IsFirstElementHighPriorityAtom(
-    const caf::message& message) {
-  return message.match_element<high_priority_atom>(0);
+    const caf::type_erased_tuple& content) {
+  return IsFirstElementAtom(content, high_priority_atom::value);
 }
 
 bool MessagePriorityActor::IsFirstElementNormalPriorityAtom(
-    const caf::message& message) {
-  return message.match_element<normal_priority_atom>(0);
+    const caf::type_erased_tuple& content) {
+  return IsFirstElementAtom(content, normal_priority_atom::value);
+}
+
+bool MessagePriorityActor::IsFirstElementAtom(
+    const caf::type_erased_tuple& content, caf::atom_value atom) {
+  return content.size() > 0 && content.match_element<caf::atom_value>(0) &&
+         content.get_as<caf::atom_value>(0) == atom;
 }
 
 void MessagePriorityActor::DeleteFirstElement(caf::message& message) {
@@ -7,6 +7,8 @@
 #include <cdcf/logger.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 class CalculatorWithPriority : public cdcf::MessagePriorityActor {
  public:
   explicit CalculatorWithPriority(caf::actor_config& cfg)
@@ -127,3 +129,44 @@ TEST_F(ActorPriorityTest,
   scoped_sender->receive([=](bool result) { EXPECT_EQ(false, result); },
                          [=](caf::error err) { ASSERT_FALSE(true); });
 }
+
+class MatrixSum : public cdcf::MessagePriorityActor {
+ public:
+  explicit MatrixSum(caf::actor_config& cfg)
+      : cdcf::MessagePriorityActor(cfg) {}
+  caf::behavior make_behavior() override {
+    return {[=](const std::vector<std::vector<int>>& matrix) -> int {
+              int sum = 0;
+              for (const auto& row : matrix) {
+                for (auto value : row) {
+                  sum += value;
+                }
+              }
+              return sum;
+            },
+            [=](caf::atom_value) -> int { return -1; }};
+  }
+};
+
+TEST(MessagePriorityActorTest, should_strip_priority_atom_from_any_payload) {
+  caf::actor_system_config config;
+  caf::actor_system system{config};
+  auto target = system.spawn<MatrixSum>();
+  std::vector<std::vector<int>> matrix(100, std::vector<int>(100, 1));
+  caf::scoped_actor self(system);
+
+  auto expect = [&](int expected) {
+    self->receive([=](int result) { EXPECT_EQ(expected, result); },
+                  [=](caf::error) { ASSERT_FALSE(true); });
+  };
+  self->request(target, caf::infinite, cdcf::high_priority_atom::value, matrix);
+  expect(10000);
+  self->request(target, caf::infinite, cdcf::normal_priority_atom::value,
+                matrix);
+  expect(10000);
+  self->request(target, caf::infinite, matrix);
+  expect(10000);
+  // other atoms are left to the behavior
+  self->request(target, caf::infinite, start_atom::value);
+  expect(-1);
+}
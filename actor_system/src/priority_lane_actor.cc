@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#include "cdcf/priority_lane_actor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cdcf {
+
+PriorityLaneActor::PriorityLaneActor(caf::actor_config& cfg,
+                                     std::vector<size_t> weights, size_t batch)
+    : SchedulingActor(cfg, batch), weights_(std::move(weights)) {
+  if (weights_.empty()) {
+    weights_.push_back(1);
+  }
+  for (auto& weight : weights_) {
+    weight = std::max<size_t>(weight, 1);
+  }
+  lanes_.resize(weights_.size());
+  deficits_.resize(weights_.size());
+  deficits_[0] = weights_[0];
+}
+
+void PriorityLaneActor::Push(caf::mailbox_element_ptr ptr,
+                             caf::execution_unit*) {
+  auto lane = LaneOf(ptr);
+  lanes_[lane].push_back(std::move(ptr));
+  ++waiting_;
+}
+
+caf::mailbox_element_ptr PriorityLaneActor::Pop(caf::execution_unit*) {
+  if (waiting_ == 0) {
+    return nullptr;
+  }
+  while (true) {
+    auto& lane = lanes_[current_];
+    if (!lane.empty() && deficits_[current_] > 0) {
+      --deficits_[current_];
+      --waiting_;
+      auto result = std::move(lane.front());
+      lane.pop_front();
+      return result;
+    }
+    if (lane.empty()) {
+      // idle lanes don't save up their turns
+      deficits_[current_] = 0;
+    }
+    current_ = (current_ + 1) % lanes_.size();
+    deficits_[current_] += weights_[current_];
+  }
+}
+
+size_t PriorityLaneActor::LaneOf(caf::mailbox_element_ptr& ptr) {
+  const auto& content = ptr->content();
+  const auto last = lanes_.size() - 1;
+  size_t lane = last;
+  size_t tag = 0;
+  if (content.size() > 0 && content.match_element<caf::atom_value>(0)) {
+    auto atom = content.get_as<caf::atom_value>(0);
+    if (atom == high_priority_atom::value) {
+      lane = 0;
+      tag = 1;
+    } else if (atom == normal_priority_atom::value) {
+      tag = 1;
+    } else if (atom == lane_atom::value && content.size() > 1 &&
+               content.match_element<int>(1)) {
+      auto requested = std::max(content.get_as<int>(1), 0);
+      lane = std::min(static_cast<size_t>(requested), last);
+      tag = 2;
+    }
+  }
+  if (tag > 0) {
+    StripTag(ptr, tag);
+  }
+  return lane;
+}
+
+}  // namespace cdcf
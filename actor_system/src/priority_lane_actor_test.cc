@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#include "cdcf/priority_lane_actor.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using hold_atom = caf::atom_constant<caf::atom("hold")>;
+
+class LaneRecorder : public cdcf::PriorityLaneActor {
+ public:
+  LaneRecorder(caf::actor_config& cfg, std::vector<size_t> weights)
+      : cdcf::PriorityLaneActor(cfg, std::move(weights)) {}
+
+  caf::behavior make_behavior() override {
+    return {[=](hold_atom) {
+              std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            },
+            [=](int lane) { handled_.push_back(lane); },
+            [=](caf::get_atom) { return handled_; }};
+  }
+
+ private:
+  std::vector<int> handled_;
+};
+
+TEST(PriorityLaneActorTest, should_serve_lanes_by_weight_without_starvation) {
+  caf::actor_system_config config;
+  caf::actor_system system{config};
+  auto target = system.spawn<LaneRecorder>(std::vector<size_t>{4, 1});
+  caf::scoped_actor self(system);
+
+  // keep target busy until all lanes are filled up
+  self->send(target, hold_atom::value);
+  for (int i = 0; i < 6; ++i) {
+    self->send(target, cdcf::lane_atom::value, 1, 1);
+  }
+  for (int i = 0; i < 6; ++i) {
+    self->send(target, cdcf::lane_atom::value, 0, 0);
+  }
+
+  std::vector<int> handled;
+  self->request(target, caf::infinite, caf::get_atom::value)
+      .receive([&](const std::vector<int>& result) { handled = result; },
+               [&](caf::error&) { ADD_FAILURE(); });
+
+  std::vector<int> expected{0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1};
+  EXPECT_EQ(expected, handled);
+}
+
+TEST(PriorityLaneActorTest, should_strip_priority_tags) {
+  caf::actor_system_config config;
+  caf::actor_system system{config};
+  auto target = system.spawn<LaneRecorder>(std::vector<size_t>{2, 1, 1});
+  caf::scoped_actor self(system);
+
+  self->send(target, cdcf::high_priority_atom::value, 0);
+  self->send(target, cdcf::normal_priority_atom::value, 2);
+  self->send(target, cdcf::lane_atom::value, 1, 1);
+  self->send(target, 2);
+
+  std::vector<int> handled;
+  self->request(target, caf::infinite, caf::get_atom::value)
+      .receive([&](const std::vector<int>& result) { handled = result; },
+               [&](caf::error&) { ADD_FAILURE(); });
+
+  EXPECT_EQ(4u, handled.size());
+}
@@ -6,6 +6,9 @@
 
 #include <cdcf/logger.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <unordered_set>
 
 #include <caf/openssl/all.hpp>
@@ -14,13 +17,21 @@
 #include "caf/io/all.hpp"
 
 namespace cdcf::router_pool {
+namespace {
+constexpr auto kSpawnTimeout = std::chrono::seconds(30);
+constexpr auto kDrainTimeout = std::chrono::seconds(10);
+}  // namespace
 
 RouterPool::RouterPool(caf::actor_config& cfg, caf::actor_system& system,
                        std::string& name, std::string& description,
                        std::string& factory_name, caf::message& factory_msg,
                        std::set<std::string>& mpi, size_t& default_actor_num,
                        caf::actor_pool::policy& policy, bool use_ssl)
-    : event_based_actor(cfg), use_ssl_(use_ssl), system_(system) {
+    : event_based_actor(cfg),
+      use_ssl_(use_ssl),
+      system_(system),
+      balanced_(false),
+      drain_timeout_(kDrainTimeout) {
   caf::scoped_actor self{system};
   caf::scoped_execution_unit context{&system};
   pool_ = caf::actor_pool::make(&context, std::move(policy));
@@ -32,10 +43,35 @@ RouterPool::RouterPool(caf::actor_config& cfg, caf::actor_system& system,
   mpi_ = std::move(mpi);
 }
 
+RouterPool::RouterPool(caf::actor_config& cfg, caf::actor_system& system,
+                       std::string& name, std::string& description,
+                       std::string& factory_name, caf::message& factory_msg,
+                       std::set<std::string>& mpi, size_t& default_actor_num,
+                       load_balancer::Policy& policy, bool use_ssl)
+    : event_based_actor(cfg),
+      use_ssl_(use_ssl),
+      system_(system),
+      balanced_(true),
+      drain_timeout_(kDrainTimeout) {
+  caf::scoped_execution_unit context{&system};
+  pool_ = load_balancer::Router::Make(&context, std::move(policy));
+  name_ = name;
+  description_ = description;
+  factory_name_ = factory_name;
+  factory_args_ = std::move(factory_msg);
+  default_actor_num_ = default_actor_num;
+  mpi_ = std::move(mpi);
+}
+
 void RouterPool::enqueue(caf::mailbox_element_ptr what,
                          caf::execution_unit* host) {
   const auto& content = what->content();
   if (content.match_elements<caf::exit_msg>()) {
+    {
+      // stop the scale ticks holding this actor
+      std::lock_guard<std::mutex> mutx(actor_lock_);
+      autoscale_.max_per_node = 0;
+    }
     send(pool_, caf::exit_msg());
     caf::event_based_actor::enqueue(std::move(what), host);
   } else if (content.match_elements<caf::down_msg>()) {
@@ -43,10 +79,8 @@ void RouterPool::enqueue(caf::mailbox_element_ptr what,
   } else if (content.match_elements<caf::sys_atom, caf::add_atom, node_atom,
                                     std::string, uint16_t>()) {
     // sys add node host port
-    bool ret =
-        AddNode(content.get_as<std::string>(3), content.get_as<uint16_t>(4));
-    what->sender->enqueue(nullptr, what->mid.response_id(),
-                          caf::make_message(ret), host);
+    AddNode(content.get_as<std::string>(3), content.get_as<uint16_t>(4),
+            ReplyTo(what));
   } else if (content.match_elements<caf::sys_atom, caf::delete_atom, node_atom,
                                     std::string, uint16_t>()) {
     // sys delete node host port
@@ -76,22 +110,86 @@ void RouterPool::enqueue(caf::mailbox_element_ptr what,
   } else if (content
                  .match_elements<caf::sys_atom, caf::update_atom, size_t>()) {
     // sys update size
-    auto ret = ModifyMaxPerNode(content.get_as<size_t>(2));
-    what->sender->enqueue(nullptr, what->mid.response_id(),
-                          caf::make_message(ret), host);
+    ModifyMaxPerNode(content.get_as<size_t>(2), ReplyTo(what));
   } else if (content.match_elements<caf::sys_atom, caf::update_atom, size_t,
                                     std::string, uint16_t>()) {
     // sys update size port host
-    auto ret = ModifyMaxPerNode(content.get_as<size_t>(2),
-                                content.get_as<std::string>(3),
-                                content.get_as<uint16_t>(4));
+    ModifyMaxPerNode(content.get_as<size_t>(2), content.get_as<std::string>(3),
+                     content.get_as<uint16_t>(4), ReplyTo(what));
+  } else if (content.match_elements<caf::sys_atom, caf::put_atom, actor_atom,
+                                    std::string, size_t,
+                                    std::vector<caf::actor>>()) {
+    // sys put actor key requested actors, from a remote spawn in flight
+    AddRemoteActors(content.get_as<std::string>(3), content.get_as<size_t>(4),
+                    content.get_as<std::vector<caf::actor>>(5), false);
+  } else if (content.match_elements<caf::sys_atom, caf::put_atom, standby_atom,
+                                    std::string, size_t,
+                                    std::vector<caf::actor>>()) {
+    // sys put standby key requested actors, from a remote spawn in flight
+    AddRemoteActors(content.get_as<std::string>(3), content.get_as<size_t>(4),
+                    content.get_as<std::vector<caf::actor>>(5), true);
+  } else if (content
+                 .match_elements<caf::sys_atom, standby_atom, size_t>()) {
+    // sys standby size
+    SetStandby(content.get_as<size_t>(2));
+    what->sender->enqueue(nullptr, what->mid.response_id(),
+                          caf::make_message(true), host);
+  } else if (content.match_elements<caf::sys_atom, scale_atom, AutoScale>()) {
+    // sys scale config
+    auto ret = EnableAutoScale(content.get_as<AutoScale>(2));
     what->sender->enqueue(nullptr, what->mid.response_id(),
                           caf::make_message(ret), host);
+  } else if (content
+                 .match_elements<caf::sys_atom, drain_atom, caf::timespan>()) {
+    // sys drain timeout
+    {
+      std::lock_guard<std::mutex> mutx(actor_lock_);
+      drain_timeout_ = content.get_as<caf::timespan>(2);
+    }
+    what->sender->enqueue(nullptr, what->mid.response_id(),
+                          caf::make_message(true), host);
+  } else if (content.match_elements<caf::sys_atom, scale_atom>()) {
+    ScaleTick();
+  } else if (content.match_elements<caf::sys_atom, scale_atom,
+                                    load_balancer::Stats>()) {
+    // sys scale stats, asked for by ScaleTick
+    Scale(content.get_as<load_balancer::Stats>(2));
   } else {
     pool_->enqueue(std::move(what), host);
   }
 }
 
+RouterPool::Done RouterPool::ReplyTo(const caf::mailbox_element_ptr& what) {
+  return [sender = what->sender, id = what->mid.response_id()](bool result) {
+    if (sender) {
+      sender->enqueue(nullptr, id, caf::make_message(result), nullptr);
+    }
+  };
+}
+
+RouterPool::Done RouterPool::AllOf(size_t count, Done done) {
+  if (count == 0) {
+    done(true);
+    return [](bool) {};
+  }
+  struct State {
+    std::atomic<size_t> left;
+    std::atomic<bool> succeeded{true};
+    Done done;
+  };
+  auto state = std::make_shared<State>();
+  state->left = count;
+  state->done = std::move(done);
+  return [state](bool result) {
+    if (!result) {
+      state->succeeded = false;
+    }
+    if (--state->left == 0) {
+      state->done(state->succeeded);
+    }
+  };
+}
+
 std::string RouterPool::BuildNodeKey(const std::string& host, uint16_t port) {
   if (host.empty()) {
     return "";
@@ -111,46 +209,80 @@ std::tuple<std::string, uint16_t> RouterPool::ParserNodeKey(
 }
 
 void RouterPool::Down(caf::down_msg& msg) {
-  DeleteActor(msg.source);
+  std::string key;
+  // routees far outnumber gateways, look them up first
+  if (DeleteActor(msg.source, key)) {
+    Promote(key);
+    Replenish(key);
+  } else if (DropStandby(msg.source, key)) {
+    Replenish(key);
+    return;
+  } else if (ForgetGateway(msg.source)) {
+    return;
+  }
   send(pool_, msg);
 }
 
-bool RouterPool::AddNode(const std::string& host, uint16_t port) {
+void RouterPool::AddNode(const std::string& host, uint16_t port, Done done) {
   auto gateway = GetSpawnActor(host, port);
   if (!host.empty()) {
     if (gateway == nullptr) {
-      return false;
+      done(false);
+      return;
     }
   }
   std::string key = BuildNodeKey(host, port);
+  std::unique_lock<std::mutex> ul(actor_lock_);
   if (nodes_.find(key) != nodes_.end()) {
-    return false;
+    ul.unlock();
+    done(false);
+    return;
   }
-  std::unique_lock<std::mutex> ul(actor_lock_);
   nodes_.insert(
       std::make_pair(key, std::move(std::unordered_set<caf::actor>())));
   ul.unlock();
+  if (gateway != nullptr) {
+    SpawnRemote(gateway, key, default_actor_num_, std::move(done), false);
+    Replenish(key);
+    return;
+  }
   for (int i = 0; i < default_actor_num_; i++) {
-    if (!AddActor(gateway, key)) {
-      return false;
+    if (!AddLocalActor(key, false)) {
+      done(false);
+      return;
     }
   }
-  return true;
+  Replenish(key);
+  done(true);
 }
 
 bool RouterPool::DeleteNode(const std::string& host, uint16_t port) {
-  std::lock_guard<std::mutex> mutx(actor_lock_);
   std::string key = BuildNodeKey(host, port);
+  ForgetGateway(key);
+  std::lock_guard<std::mutex> mutx(actor_lock_);
   auto node_it = nodes_.find(key);
   if (node_it == nodes_.end()) {
     return false;
   }
   auto actors = std::move(node_it->second);
   nodes_.erase(node_it);
+  pending_.erase(key);
+  cancelled_.erase(key);
+  trends_.erase(key);
   for (const auto& it : actors) {
-    anon_send(it, caf::exit_reason::user_shutdown);
-    // anon_send(pool_, caf::sys_atom(), caf::delete_atom(), it);
+    owners_.erase(it.address());
+    Retire(it);
+  }
+  auto standby_it = standbys_.find(key);
+  if (standby_it != standbys_.end()) {
+    for (const auto& it : standby_it->second) {
+      standby_owners_.erase(it.address());
+      this->demonitor(it);
+      anon_send(it, caf::exit_reason::user_shutdown);
+    }
+    standbys_.erase(standby_it);
   }
+  standby_pending_.erase(key);
   return true;
 }
 
@@ -163,56 +295,99 @@ std::vector<std::string> RouterPool::GetNode() {
   return std::move(result);
 }
 
-bool RouterPool::ModifyMaxPerNode(size_t size) {
+void RouterPool::ModifyMaxPerNode(size_t size, Done done) {
   default_actor_num_ = size;
-  for (auto& node_it : nodes_) {
-    auto [host, port] = ParserNodeKey(node_it.first);
-    ModifyMaxPerNode(size, host, port);
+  std::vector<std::string> keys;
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    for (auto& node_it : nodes_) {
+      keys.push_back(node_it.first);
+    }
+  }
+  auto node_done = AllOf(keys.size(), std::move(done));
+  for (auto& key : keys) {
+    auto [host, port] = ParserNodeKey(key);
+    ModifyMaxPerNode(size, host, port, node_done);
   }
-  return true;
 }
 
-bool RouterPool::ModifyMaxPerNode(size_t size, const std::string& host,
-                                  uint16_t port) {
+void RouterPool::ModifyMaxPerNode(size_t size, const std::string& host,
+                                  uint16_t port, Done done) {
   std::string key = BuildNodeKey(host, port);
+  std::unique_lock<std::mutex> ul(actor_lock_);
   auto it = nodes_.find(key);
   if (it == nodes_.end()) {
-    return false;
+    ul.unlock();
+    done(false);
+    return;
   }
-  auto pre_size = it->second.size();
-  if (pre_size > size) {
-    return DeleteActor(key, pre_size - size);
+  /* routees being spawned count, so resizing again doesn't overshoot. */
+  auto active = it->second.size();
+  auto spawning = Spawning(key);
+  if (active + spawning > size) {
+    // cancel routees being spawned first, they are stopped as they arrive
+    auto cut = std::min(active + spawning - size, spawning);
+    if (cut > 0) {
+      cancelled_[key] += cut;
+    }
+    ul.unlock();
+    done(DeleteActor(key, active + spawning - cut - size));
+    return;
   }
+  auto cancelled = cancelled_.find(key);
+  if (active + spawning < size && cancelled != cancelled_.end()) {
+    // take cancelled ones back before spawning more
+    auto restored = std::min(size - active - spawning, cancelled->second);
+    cancelled->second -= restored;
+    spawning += restored;
+    if (cancelled->second == 0) {
+      cancelled_.erase(cancelled);
+    }
+  }
+  auto pre_size = active + spawning;
+  ul.unlock();
   if (pre_size < size) {
-    caf::actor gateway = nullptr;
     if (!key.empty()) {
-      gateway = GetSpawnActor(host, port);
+      auto gateway = GetSpawnActor(host, port);
       if (gateway == nullptr) {
-        return false;
+        done(false);
+        return;
       }
+      SpawnRemote(gateway, key, size - pre_size, std::move(done), false);
+      return;
     }
     for (int i = 0; i < size - pre_size; i++) {
-      if (!AddActor(gateway, key)) {
-        return false;
+      if (!AddLocalActor(key, false)) {
+        done(false);
+        return;
       }
     }
   }
-  return true;
+  done(true);
 }
 
-bool RouterPool::DeleteActor(caf::actor_addr& actor_addr) {
+bool RouterPool::DeleteActor(const caf::actor_addr& actor_addr,
+                             std::string& key) {
   //  aout(this) << "delete actor : " << actor_addr << "" << std::endl;
   std::unique_lock<std::mutex> mutx(actor_lock_);
-  for (auto& node_it : nodes_) {
-    for (auto& actor_it : node_it.second) {
-      if (actor_it.address() == actor_addr) {
-        this->demonitor(actor_it);
-        node_it.second.erase(actor_it);
-        return true;
-      }
-    }
+  auto owner = owners_.find(actor_addr);
+  if (owner == owners_.end()) {
+    return false;
   }
-  return false;
+  key = owner->second;
+  auto node_it = nodes_.find(key);
+  owners_.erase(owner);
+  if (node_it == nodes_.end()) {
+    return false;
+  }
+  auto& actor_set = node_it->second;
+  auto actor_it = actor_set.find(caf::actor_cast<caf::actor>(actor_addr));
+  if (actor_it == actor_set.end()) {
+    return false;
+  }
+  this->demonitor(*actor_it);
+  actor_set.erase(actor_it);
+  return true;
 }
 
 bool RouterPool::DeleteActor(const std::string& key, size_t num) {
@@ -223,69 +398,281 @@ bool RouterPool::DeleteActor(const std::string& key, size_t num) {
   }
   auto& actor_set = it->second;
   size_t count = 0;
-  for (auto& actor : actor_set) {
-    if (count >= num) {
-      break;
-    }
-    anon_send(actor, caf::exit_reason::user_shutdown);
-    //    caf::scoped_actor self(system_);
-    //    std::promise<bool> promise_;
-    //    self->request(actor, caf::infinite, caf::exit_reason::user_shutdown)
-    //        .receive(
-    //            [&](bool result) { promise_.set_value(result); },
-    //            [&](const caf::error& err) { promise_.set_value(0); });
-    //    bool result = promise_.get_future().get();
-    count++;
+  for (auto actor_it = actor_set.begin();
+       actor_it != actor_set.end() && count < num; ++count) {
+    auto actor = *actor_it;
+    actor_it = actor_set.erase(actor_it);
+    owners_.erase(actor.address());
+    Retire(actor);
   }
   CDCF_LOGGER_INFO("Successfully delete actor.");
   return true;
 }
 
-bool RouterPool::AddActor(const caf::actor& gateway, const std::string& key) {
+void RouterPool::Retire(const caf::actor& actor) {
+  this->demonitor(actor);
+  // pool routes nothing more to it once this returns
+  anon_send(pool_, caf::sys_atom::value, caf::delete_atom::value, actor);
+  // queued behind the messages it's still to work on
+  anon_send(actor, caf::exit_reason::user_shutdown);
+  caf::delayed_anon_send(
+      actor, drain_timeout_,
+      caf::exit_msg{address(), caf::exit_reason::user_shutdown});
+}
+
+bool RouterPool::AddLocalActor(const std::string& key, bool standby) {
   std::unique_lock<std::mutex> mutx(actor_lock_);
   auto it = nodes_.find(key);
   if (it == nodes_.end()) {
     return false;
   }
-  std::unordered_set<caf::actor>& actor_set = it->second;
-  caf::actor add_actor = nullptr;
-  if (gateway == nullptr && key.empty()) {
-    // local spawn
-    auto res = system().spawn<caf::actor>(factory_name_, factory_args_, nullptr,
-                                          true, &mpi_);
-    if (res) {
-      CDCF_LOGGER_INFO("Successfully spawn local actor.");
-      add_actor = std::move(*res);
-    }
+  auto res = system().spawn<caf::actor>(factory_name_, factory_args_, nullptr,
+                                        true, &mpi_);
+  if (!res) {
+    return false;
+  }
+  CDCF_LOGGER_INFO("Successfully spawn local actor.");
+  auto add_actor = std::move(*res);
+  if (standby) {
+    standbys_[key].push_back(add_actor);
+    standby_owners_.emplace(add_actor.address(), key);
   } else {
-    // remote spawn
-    std::promise<caf::actor> promise;
-    auto tout = std::chrono::seconds(30);  // wait no longer than 30s
-    caf::scoped_actor self(system());
-    self->request(gateway, tout, caf::spawn_atom::value, factory_name_,
-                  factory_args_, mpi_, name_, description_)
-        .receive([&](caf::actor& ret) { promise.set_value(std::move(ret)); },
-                 [&](caf::error& err) {
-                   CDCF_LOGGER_ERROR(
-                       "can't spawn actor from gateway, error: {}",
-                       caf::to_string(err));
-                   promise.set_value(nullptr);
-                 });
-    add_actor = promise.get_future().get();
-  }
-  if (add_actor != nullptr) {
     anon_send(pool_, caf::sys_atom::value, caf::put_atom::value, add_actor);
-    actor_set.insert(add_actor);
-    this->monitor(add_actor);
-    return true;
+    it->second.insert(add_actor);
+    owners_.emplace(add_actor.address(), key);
+  }
+  this->monitor(add_actor);
+  return true;
+}
+
+void RouterPool::SpawnRemote(const caf::actor& gateway, const std::string& key,
+                             size_t count, Done done, bool standby) {
+  if (count == 0) {
+    done(true);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    (standby ? standby_pending_ : pending_)[key] += count;
+  }
+  caf::atom_value role = actor_atom::value;
+  if (standby) {
+    role = standby_atom::value;
+  }
+  auto pool = caf::actor_cast<caf::actor>(this);
+  auto spawn_many =
+      caf::make_message(caf::spawn_atom::value, count, factory_name_,
+                        factory_args_, mpi_, name_, description_);
+  auto spawn_one = caf::make_message(caf::spawn_atom::value, factory_name_,
+                                     factory_args_, mpi_, name_, description_);
+  // a short-lived actor awaits the responses, pool never blocks on them.
+  system().spawn([=](caf::event_based_actor* self) {
+    auto left = std::make_shared<size_t>(count);
+    auto succeeded = std::make_shared<bool>(true);
+    /* fold routees spawned for `requested` of the pending ones. */
+    auto fold = [=](size_t requested, std::vector<caf::actor> actors) {
+      *succeeded = *succeeded && actors.size() == requested;
+      self->send(pool, caf::sys_atom::value, caf::put_atom::value, role, key,
+                 requested, std::move(actors));
+      *left -= requested;
+      if (*left == 0) {
+        done(*succeeded);
+        self->quit();
+      }
+    };
+    auto spawn_each = [=] {
+      for (size_t i = 0; i < count; ++i) {
+        self->request(gateway, kSpawnTimeout, spawn_one)
+            .then(
+                [=](caf::actor& actor) {
+                  fold(1, actor ? std::vector<caf::actor>{actor}
+                                : std::vector<caf::actor>{});
+                },
+                [=](caf::error& err) {
+                  CDCF_LOGGER_ERROR(
+                      "can't spawn actor from gateway, error: {}",
+                      caf::to_string(err));
+                  fold(1, {});
+                });
+      }
+    };
+    self->request(gateway, kSpawnTimeout, spawn_many)
+        .then(
+            [=](std::vector<caf::actor>& actors) {
+              if (actors.size() > count) {
+                actors.resize(count);
+              }
+              fold(count, std::move(actors));
+            },
+            [=](caf::error& err) {
+              if (err == caf::sec::unexpected_message) {
+                // gateway without batch spawn, one request per routee
+                spawn_each();
+                return;
+              }
+              CDCF_LOGGER_ERROR("can't spawn actors from gateway, error: {}",
+                                caf::to_string(err));
+              fold(count, {});
+            });
+  });
+}
+
+size_t RouterPool::Spawning(const std::string& key) const {
+  auto pending = pending_.find(key);
+  if (pending == pending_.end()) {
+    return 0;
+  }
+  auto cancelled = cancelled_.find(key);
+  return pending->second -
+         (cancelled == cancelled_.end() ? 0 : cancelled->second);
+}
+
+void RouterPool::AddRemoteActors(const std::string& key, size_t requested,
+                                 const std::vector<caf::actor>& actors,
+                                 bool standby) {
+  std::lock_guard<std::mutex> mutx(actor_lock_);
+  auto& pending_map = standby ? standby_pending_ : pending_;
+  auto pending = pending_map.find(key);
+  size_t left = 0;
+  if (pending != pending_map.end()) {
+    pending->second -= std::min(pending->second, requested);
+    left = pending->second;
+    if (pending->second == 0) {
+      pending_map.erase(pending);
+    }
+  }
+  auto cancelled = standby ? cancelled_.end() : cancelled_.find(key);
+  auto it = nodes_.find(key);
+  for (const auto& actor : actors) {
+    if (it == nodes_.end()) {
+      // node get deleted while spawning
+      anon_send(actor, caf::exit_reason::user_shutdown);
+      continue;
+    }
+    if (cancelled != cancelled_.end() && cancelled->second > 0) {
+      // node shrunk while spawning
+      --cancelled->second;
+      anon_send(actor, caf::exit_reason::user_shutdown);
+      continue;
+    }
+    if (standby) {
+      standbys_[key].push_back(actor);
+      standby_owners_.emplace(actor.address(), key);
+    } else {
+      anon_send(pool_, caf::sys_atom::value, caf::put_atom::value, actor);
+      it->second.insert(actor);
+      owners_.emplace(actor.address(), key);
+    }
+    this->monitor(actor);
+  }
+  if (cancelled != cancelled_.end()) {
+    // routees failed to spawn can't be cancelled any more
+    cancelled->second = std::min(cancelled->second, left);
+    if (cancelled->second == 0) {
+      cancelled_.erase(cancelled);
+    }
+  }
+}
+
+void RouterPool::SetStandby(size_t size) {
+  std::vector<std::string> keys;
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    standby_per_node_ = size;
+    for (auto& [key, standbys] : standbys_) {
+      while (standbys.size() > size) {
+        auto actor = std::move(standbys.back());
+        standbys.pop_back();
+        standby_owners_.erase(actor.address());
+        this->demonitor(actor);
+        anon_send(actor, caf::exit_reason::user_shutdown);
+      }
+    }
+    for (auto& node_it : nodes_) {
+      keys.push_back(node_it.first);
+    }
+  }
+  for (const auto& key : keys) {
+    Replenish(key);
+  }
+}
+
+void RouterPool::Promote(const std::string& key) {
+  std::lock_guard<std::mutex> mutx(actor_lock_);
+  auto node_it = nodes_.find(key);
+  auto standby_it = standbys_.find(key);
+  if (node_it == nodes_.end() || standby_it == standbys_.end() ||
+      standby_it->second.empty()) {
+    return;
+  }
+  auto actor = std::move(standby_it->second.back());
+  standby_it->second.pop_back();
+  standby_owners_.erase(actor.address());
+  anon_send(pool_, caf::sys_atom::value, caf::put_atom::value, actor);
+  node_it->second.insert(actor);
+  owners_.emplace(actor.address(), key);
+}
+
+bool RouterPool::DropStandby(const caf::actor_addr& actor, std::string& key) {
+  std::lock_guard<std::mutex> mutx(actor_lock_);
+  auto owner = standby_owners_.find(actor);
+  if (owner == standby_owners_.end()) {
+    return false;
+  }
+  key = owner->second;
+  standby_owners_.erase(owner);
+  auto& standbys = standbys_[key];
+  auto it = std::find(standbys.begin(), standbys.end(), actor);
+  if (it != standbys.end()) {
+    standbys.erase(it);
+  }
+  return true;
+}
+
+void RouterPool::Replenish(const std::string& key) {
+  size_t count = 0;
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    if (nodes_.find(key) == nodes_.end()) {
+      return;
+    }
+    auto standby_it = standbys_.find(key);
+    auto pending = standby_pending_.find(key);
+    auto have =
+        (standby_it == standbys_.end() ? 0 : standby_it->second.size()) +
+        (pending == standby_pending_.end() ? 0 : pending->second);
+    count = standby_per_node_ > have ? standby_per_node_ - have : 0;
+  }
+  if (count == 0) {
+    return;
+  }
+  if (key.empty()) {
+    for (size_t i = 0; i < count; ++i) {
+      if (!AddLocalActor(key, true)) {
+        break;
+      }
+    }
+    return;
+  }
+  auto [host, port] = ParserNodeKey(key);
+  auto gateway = GetSpawnActor(host, port);
+  if (gateway != nullptr) {
+    SpawnRemote(gateway, key, count, [](bool) {}, true);
   }
-  return false;
 }
 
 caf::actor RouterPool::GetSpawnActor(const std::string& host, uint16_t port) {
   if (host.empty()) {
     return nullptr;
   }
+  auto key = BuildNodeKey(host, port);
+  {
+    std::lock_guard<std::mutex> mutx(gateway_lock_);
+    auto it = gateways_.find(key);
+    if (it != gateways_.end()) {
+      return it->second;
+    }
+  }
   auto remote_actor = caf::io::remote_actor<>;
   if (use_ssl_) {
     remote_actor = caf::openssl::remote_actor<>;
@@ -297,7 +684,147 @@ caf::actor RouterPool::GetSpawnActor(const std::string& host, uint16_t port) {
               << std::endl;
     return nullptr;
   }
-  return *gateway;
+  std::lock_guard<std::mutex> mutx(gateway_lock_);
+  auto [it, inserted] = gateways_.emplace(key, *gateway);
+  if (inserted) {
+    // proxy goes down once connection is lost, then it's dropped from cache
+    this->monitor(it->second);
+  }
+  return it->second;
+}
+
+bool RouterPool::ForgetGateway(const caf::actor_addr& gateway) {
+  std::lock_guard<std::mutex> mutx(gateway_lock_);
+  for (auto it = gateways_.begin(); it != gateways_.end(); ++it) {
+    if (it->second.address() == gateway) {
+      gateways_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RouterPool::ForgetGateway(const std::string& key) {
+  std::lock_guard<std::mutex> mutx(gateway_lock_);
+  auto it = gateways_.find(key);
+  if (it == gateways_.end()) {
+    return;
+  }
+  this->demonitor(it->second);
+  gateways_.erase(it);
+}
+
+bool RouterPool::EnableAutoScale(const AutoScale& config) {
+  if (!balanced_) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    autoscale_ = config;
+    autoscale_.min_per_node =
+        std::min(autoscale_.min_per_node, autoscale_.max_per_node);
+    trends_.clear();
+  }
+  if (config.max_per_node > 0 && !scaling_.exchange(true)) {
+    ScaleTick();
+  }
+  return true;
+}
+
+void RouterPool::ScaleTick() {
+  std::chrono::milliseconds interval;
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    if (autoscale_.max_per_node == 0) {
+      scaling_ = false;
+      return;
+    }
+    interval = autoscale_.interval;
+  }
+  // a short-lived actor awaits the stats, a reply sent to this pool would be
+  // routed to a routee as any other message
+  auto router_pool = caf::actor_cast<caf::actor>(this);
+  system().spawn([=, pool = pool_](caf::event_based_actor* self) {
+    self->request(pool, interval, caf::sys_atom::value, caf::get_atom::value,
+                  load_balancer::stats_atom::value)
+        .then(
+            [=](load_balancer::Stats& stats) {
+              self->send(router_pool, caf::sys_atom::value, scale_atom::value,
+                         std::move(stats));
+            },
+            [](caf::error& err) {
+              CDCF_LOGGER_ERROR("can't get stats for autoscale, error: {}",
+                                caf::to_string(err));
+            });
+  });
+  caf::delayed_anon_send(caf::actor_cast<caf::actor>(this), interval,
+                         caf::sys_atom::value, scale_atom::value);
+}
+
+void RouterPool::Scale(const load_balancer::Stats& stats) {
+  std::unordered_map<caf::actor, size_t> index;
+  for (size_t i = 0; i < stats.workers.size(); ++i) {
+    index.emplace(stats.workers[i], i);
+  }
+  std::vector<std::pair<std::string, size_t>> resizes;
+  {
+    std::lock_guard<std::mutex> mutx(actor_lock_);
+    const auto& config = autoscale_;
+    if (config.max_per_node == 0) {
+      return;
+    }
+    const auto target_backlog =
+        std::max((config.high_backlog + config.low_backlog) / 2, 1e-3);
+    for (const auto& [key, actors] : nodes_) {
+      size_t load = 0;
+      uint64_t latency = 0;
+      size_t sampled = 0;
+      for (const auto& actor : actors) {
+        auto it = index.find(actor);
+        if (it == index.end()) {
+          continue;
+        }
+        load += stats.loads[it->second];
+        if (stats.latencies[it->second] > 0) {
+          latency += stats.latencies[it->second];
+          ++sampled;
+        }
+      }
+      if (sampled > 0) {
+        latency /= sampled;
+      }
+      auto size = actors.size() + Spawning(key);
+      auto backlog = size == 0 ? 0 : static_cast<double>(load) / size;
+      const auto high_latency =
+          static_cast<uint64_t>(config.high_latency.count());
+      auto hot = backlog > config.high_backlog ||
+                 (high_latency > 0 && latency > high_latency);
+      auto cold = backlog < config.low_backlog &&
+                  (high_latency == 0 || latency < high_latency / 2);
+      auto& trend = trends_[key];
+      trend.above = hot ? trend.above + 1 : 0;
+      trend.below = cold ? trend.below + 1 : 0;
+      // aim at the middle of the watermarks, one routee at least
+      auto wanted = static_cast<size_t>(std::ceil(load / target_backlog));
+      auto target = size;
+      if (size < config.min_per_node || size > config.max_per_node) {
+        target = std::clamp(size, config.min_per_node, config.max_per_node);
+      } else if (trend.above >= config.patience) {
+        target = std::min(std::max(size + 1, wanted), config.max_per_node);
+      } else if (trend.below >= config.patience && size > 0) {
+        target = std::max(std::min(size - 1, wanted), config.min_per_node);
+      }
+      if (target != size) {
+        resizes.emplace_back(key, target);
+        trend = {};
+      }
+    }
+  }
+  for (const auto& [key, size] : resizes) {
+    auto [host, port] = ParserNodeKey(key);
+    CDCF_LOGGER_INFO("autoscale node {} to {} routees", key, size);
+    ModifyMaxPerNode(size, host, port, [](bool) {});
+  }
 }
 
 std::vector<caf::actor> RouterPool::GetActors() {
@@ -5,6 +5,11 @@
 #include <cdcf/router_pool/router_pool.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
 #include "./router_pool_test_config.h"
 #include "caf/io/all.hpp"
 
@@ -13,6 +18,46 @@ using sub_atom = caf::atom_constant<caf::atom("sub")>;
 
 const size_t kDefaultActorSize = 3;
 
+caf::behavior fake_gateway(caf::event_based_actor* self) {
+  return {[=](caf::spawn_atom, const std::string& name,
+              const caf::message& args, const std::set<std::string>& ifs,
+              const std::string& pool_name,
+              const std::string& pool_description) {
+    return caf::actor_cast<caf::actor>(self->spawn(simple_calculator_fun));
+  }};
+}
+
+caf::behavior fake_batch_gateway(caf::event_based_actor* self,
+                                 std::shared_ptr<std::atomic<int>> requests) {
+  return {[=](caf::spawn_atom, size_t count, const std::string& name,
+              const caf::message& args, const std::set<std::string>& ifs,
+              const std::string& pool_name,
+              const std::string& pool_description) {
+    ++*requests;
+    std::vector<caf::actor> result;
+    for (size_t i = 0; i < count; ++i) {
+      result.push_back(
+          caf::actor_cast<caf::actor>(self->spawn(simple_calculator_fun)));
+    }
+    return result;
+  }};
+}
+
+caf::behavior fake_slow_batch_gateway(caf::event_based_actor* self) {
+  return {[=](caf::spawn_atom, size_t count, const std::string& name,
+              const caf::message& args, const std::set<std::string>& ifs,
+              const std::string& pool_name,
+              const std::string& pool_description) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::vector<caf::actor> result;
+    for (size_t i = 0; i < count; ++i) {
+      result.push_back(
+          caf::actor_cast<caf::actor>(self->spawn(simple_calculator_fun)));
+    }
+    return result;
+  }};
+}
+
 class RouterPoolTest : public ::testing::Test {
   void SetUp() override {
     std::string pool_name = "pool name";
@@ -335,3 +380,364 @@ TEST_F(RouterPoolTest, get_actors_use_host_ports) {
   int result = promise_.get_future().get();
   EXPECT_EQ(3, result);
 }
+
+TEST_F(RouterPoolTest, should_spawn_routees_on_remote_node) {
+  auto gateway = system_.spawn(fake_gateway);
+  auto port = system_.middleman().publish(gateway, 0);
+  ASSERT_TRUE(port);
+  caf::scoped_actor self(system_);
+
+  bool added = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](bool ret) { added = ret; },
+               [&](const caf::error& err) { added = false; });
+  size_t result = 0;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+               [&](const caf::error& err) { result = 0; });
+
+  EXPECT_EQ(true, added);
+  EXPECT_EQ(kDefaultActorSize, result);
+}
+
+TEST_F(RouterPoolTest, should_spawn_routees_in_one_request_if_gateway_can) {
+  auto requests = std::make_shared<std::atomic<int>>(0);
+  auto gateway = system_.spawn(fake_batch_gateway, requests);
+  auto port = system_.middleman().publish(gateway, 0);
+  ASSERT_TRUE(port);
+  caf::scoped_actor self(system_);
+
+  bool added = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](bool ret) { added = ret; },
+               [&](const caf::error& err) { added = false; });
+  bool updated = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::update_atom::value, kDefaultActorSize + 2,
+                std::string("127.0.0.1"), *port)
+      .receive([&](bool ret) { updated = ret; },
+               [&](const caf::error& err) { updated = false; });
+  size_t result = 0;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+               [&](const caf::error& err) { result = 0; });
+
+  EXPECT_TRUE(added);
+  EXPECT_TRUE(updated);
+  EXPECT_EQ(kDefaultActorSize + 2, result);
+  EXPECT_EQ(2, requests->load());
+}
+
+TEST_F(RouterPoolTest, should_reuse_gateway_connection_when_resizing) {
+  auto gateway = system_.spawn(fake_gateway);
+  auto port = system_.middleman().publish(gateway, 0);
+  ASSERT_TRUE(port);
+  caf::scoped_actor self(system_);
+  bool added = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](bool ret) { added = ret; },
+               [&](const caf::error& err) { added = false; });
+  ASSERT_TRUE(added);
+
+  // no new connection could be made from now on
+  system_.middleman().unpublish(gateway, *port);
+  bool updated = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::update_atom::value, kDefaultActorSize + 1,
+                std::string("127.0.0.1"), *port)
+      .receive([&](bool ret) { updated = ret; },
+               [&](const caf::error& err) { updated = false; });
+  size_t result = 0;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+               [&](const caf::error& err) { result = 0; });
+
+  EXPECT_TRUE(updated);
+  EXPECT_EQ(kDefaultActorSize + 1, result);
+}
+
+TEST_F(RouterPoolTest, should_not_overshoot_when_shrinking_while_spawning) {
+  auto gateway = system_.spawn(fake_slow_batch_gateway);
+  auto port = system_.middleman().publish(gateway, 0);
+  ASSERT_TRUE(port);
+  caf::scoped_actor self(system_);
+  bool added = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](bool ret) { added = ret; },
+               [&](const caf::error& err) { added = false; });
+  ASSERT_TRUE(added);
+
+  auto grow = self->request(pool_, caf::infinite, caf::sys_atom::value,
+                            caf::update_atom::value, kDefaultActorSize + 3,
+                            std::string("127.0.0.1"), *port);
+  // routees of the growth are still being spawned
+  auto shrink = self->request(pool_, caf::infinite, caf::sys_atom::value,
+                              caf::update_atom::value, static_cast<size_t>(2),
+                              std::string("127.0.0.1"), *port);
+  shrink.receive([&](bool ret) {}, [&](const caf::error& err) {});
+  grow.receive([&](bool ret) {}, [&](const caf::error& err) {});
+  size_t result = 0;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value,
+                "127.0.0.1", *port)
+      .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+               [&](const caf::error& err) { result = 0; });
+
+  EXPECT_EQ(2, result);
+}
+
+TEST_F(RouterPoolTest, should_route_by_load_balancer_policy) {
+  std::string pool_name = "local first pool";
+  std::string pool_description = "pool description";
+  std::string routee_name = "simple_calculator";
+  auto routee_args = caf::make_message();
+  auto routee_ifs = system_.message_types<simple_calculator>();
+  size_t default_actor_num = kDefaultActorSize;
+  auto policy = cdcf::load_balancer::policy::LocalFirst();
+  bool use_ssl = false;
+  auto pool = system_.spawn<cdcf::router_pool::RouterPool>(
+      system_, pool_name, pool_description, routee_name, routee_args,
+      routee_ifs, default_actor_num, policy, use_ssl);
+  caf::scoped_actor self(system_);
+  bool added = false;
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value, "",
+                static_cast<uint16_t>(0))
+      .receive([&](bool ret) { added = ret; },
+               [&](const caf::error& err) { added = false; });
+  ASSERT_TRUE(added);
+
+  int sum = 0;
+  self->request(pool, caf::infinite, 1, 2)
+      .receive([&](int result, caf::actor_id) { sum = result; },
+               [&](const caf::error& err) { sum = 0; });
+  cdcf::load_balancer::Stats stats;
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::load_balancer::stats_atom::value)
+      .receive([&](cdcf::load_balancer::Stats& result) { stats = result; },
+               [&](const caf::error& err) {});
+
+  EXPECT_EQ(3, sum);
+  EXPECT_EQ(kDefaultActorSize, stats.workers.size());
+  EXPECT_EQ(1, stats.replied);
+  self->send_exit(pool, caf::exit_reason::user_shutdown);
+}
+
+TEST_F(RouterPoolTest, should_not_autoscale_without_load_balancer_policy) {
+  caf::scoped_actor self(system_);
+  cdcf::router_pool::AutoScale config;
+  config.max_per_node = 5;
+  bool enabled = true;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                cdcf::router_pool::scale_atom::value, config)
+      .receive([&](bool ret) { enabled = ret; },
+               [&](const caf::error& err) { enabled = true; });
+  EXPECT_FALSE(enabled);
+}
+
+TEST_F(RouterPoolTest, should_shrink_idle_node_to_min_when_autoscaling) {
+  std::string pool_name = "autoscale pool";
+  std::string pool_description = "pool description";
+  std::string routee_name = "simple_calculator";
+  auto routee_args = caf::make_message();
+  auto routee_ifs = system_.message_types<simple_calculator>();
+  size_t default_actor_num = kDefaultActorSize;
+  auto policy = cdcf::load_balancer::policy::MinLoad();
+  bool use_ssl = false;
+  auto pool = system_.spawn<cdcf::router_pool::RouterPool>(
+      system_, pool_name, pool_description, routee_name, routee_args,
+      routee_ifs, default_actor_num, policy, use_ssl);
+  caf::scoped_actor self(system_);
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value, "",
+                static_cast<uint16_t>(0))
+      .receive([&](bool ret) {}, [&](const caf::error& err) {});
+  cdcf::router_pool::AutoScale config;
+  config.min_per_node = 1;
+  config.max_per_node = 5;
+  config.interval = std::chrono::milliseconds(10);
+  config.patience = 2;
+  bool enabled = false;
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                cdcf::router_pool::scale_atom::value, config)
+      .receive([&](bool ret) { enabled = ret; },
+               [&](const caf::error& err) { enabled = false; });
+  ASSERT_TRUE(enabled);
+
+  size_t result = 0;
+  for (int i = 0; i < 100 && result != 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    self->request(pool, caf::infinite, caf::sys_atom::value,
+                  caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+        .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+                 [&](const caf::error& err) { result = 0; });
+  }
+
+  EXPECT_EQ(1, result);
+  config.max_per_node = 0;
+  self->send(pool, caf::sys_atom::value, cdcf::router_pool::scale_atom::value,
+             config);
+  self->send_exit(pool, caf::exit_reason::user_shutdown);
+}
+
+TEST_F(RouterPoolTest, should_grow_busy_node_when_autoscaling) {
+  std::string pool_name = "autoscale pool";
+  std::string pool_description = "pool description";
+  std::string routee_name = "slow_calculator";
+  auto routee_args = caf::make_message();
+  auto routee_ifs = system_.message_types<simple_calculator>();
+  size_t default_actor_num = 1;
+  auto policy = cdcf::load_balancer::policy::MinLoad();
+  bool use_ssl = false;
+  auto pool = system_.spawn<cdcf::router_pool::RouterPool>(
+      system_, pool_name, pool_description, routee_name, routee_args,
+      routee_ifs, default_actor_num, policy, use_ssl);
+  caf::scoped_actor self(system_);
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value, "",
+                static_cast<uint16_t>(0))
+      .receive([&](bool ret) {}, [&](const caf::error& err) {});
+  cdcf::router_pool::AutoScale config;
+  config.min_per_node = 1;
+  config.max_per_node = 4;
+  config.interval = std::chrono::milliseconds(10);
+  config.high_backlog = 2;
+  config.low_backlog = 0;
+  config.patience = 2;
+  bool enabled = false;
+  self->request(pool, caf::infinite, caf::sys_atom::value,
+                cdcf::router_pool::scale_atom::value, config)
+      .receive([&](bool ret) { enabled = ret; },
+               [&](const caf::error& err) { enabled = false; });
+  ASSERT_TRUE(enabled);
+
+  // far more than one routee works off within the checks
+  for (int i = 0; i < 200; ++i) {
+    self->request(pool, caf::infinite, i, 1);
+  }
+  size_t result = 0;
+  for (int i = 0; i < 100 && result < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    self->request(pool, caf::infinite, caf::sys_atom::value,
+                  caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+        .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+                 [&](const caf::error& err) { result = 0; });
+  }
+
+  EXPECT_LE(2, result);
+  config.max_per_node = 0;
+  self->send(pool, caf::sys_atom::value, cdcf::router_pool::scale_atom::value,
+             config);
+  self->send_exit(pool, caf::exit_reason::user_shutdown);
+}
+
+TEST_F(RouterPoolTest, should_keep_new_routees_when_old_ones_of_node_go_down) {
+  caf::scoped_actor self(system_);
+  auto add_node = [&] {
+    self->request(pool_, caf::infinite, caf::sys_atom::value,
+                  caf::add_atom::value, cdcf::router_pool::node_atom::value,
+                  "", static_cast<uint16_t>(0))
+        .receive([&](bool ret) {}, [&](const caf::error& err) {});
+  };
+  add_node();
+  std::vector<caf::actor> old_routees;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+      .receive([&](std::vector<caf::actor>& ret) { old_routees = ret; },
+               [&](const caf::error& err) {});
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::delete_atom::value, cdcf::router_pool::node_atom::value,
+                "", static_cast<uint16_t>(0))
+      .receive([&](bool& ret) {}, [&](const caf::error& err) {});
+  add_node();
+  for (auto& routee : old_routees) {
+    self->wait_for(routee);
+  }
+  // let down messages of old routees reach the pool
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  size_t result = 0;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+      .receive([&](std::vector<caf::actor>& ret) { result = ret.size(); },
+               [&](const caf::error& err) { result = 0; });
+  EXPECT_EQ(kDefaultActorSize, result);
+}
+
+TEST_F(RouterPoolTest, should_answer_all_requests_while_shrinking) {
+  caf::scoped_actor self(system_);
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value, "",
+                static_cast<uint16_t>(0))
+      .receive([&](bool ret) {}, [&](const caf::error& err) {});
+  self->send(pool_, caf::sys_atom::value, caf::update_atom::value,
+             static_cast<size_t>(1));
+
+  const int requests = 20;
+  int answered = 0;
+  for (int i = 0; i < requests; ++i) {
+    self->request(pool_, caf::infinite, i, 1)
+        .receive(
+            [&](int result, caf::actor_id) { answered += result == i + 1; },
+            [&](const caf::error& err) {});
+  }
+
+  EXPECT_EQ(requests, answered);
+}
+
+TEST_F(RouterPoolTest, should_promote_standby_when_routee_goes_down) {
+  caf::scoped_actor self(system_);
+  bool standby = false;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                cdcf::router_pool::standby_atom::value, static_cast<size_t>(1))
+      .receive([&](bool ret) { standby = ret; },
+               [&](const caf::error& err) { standby = false; });
+  ASSERT_TRUE(standby);
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::add_atom::value, cdcf::router_pool::node_atom::value, "",
+                static_cast<uint16_t>(0))
+      .receive([&](bool ret) {}, [&](const caf::error& err) {});
+  std::vector<caf::actor> before;
+  self->request(pool_, caf::infinite, caf::sys_atom::value,
+                caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+      .receive([&](std::vector<caf::actor>& ret) { before = ret; },
+               [&](const caf::error& err) {});
+
+  // quit one of routees
+  self->request(pool_, caf::infinite, -1, -1)
+      .receive([&](int result, caf::actor_id id) {},
+               [&](const caf::error& err) {});
+  std::vector<caf::actor> after;
+  for (int i = 0; i < 50; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    self->request(pool_, caf::infinite, caf::sys_atom::value,
+                  caf::get_atom::value, cdcf::router_pool::actor_atom::value)
+        .receive([&](std::vector<caf::actor>& ret) { after = ret; },
+                 [&](const caf::error& err) {});
+    if (std::any_of(after.begin(), after.end(), [&](auto& actor) {
+          return std::find(before.begin(), before.end(), actor) == before.end();
+        })) {
+      break;
+    }
+  }
+
+  EXPECT_EQ(kDefaultActorSize, after.size());
+  EXPECT_EQ(1, std::count_if(after.begin(), after.end(), [&](auto& actor) {
+              return std::find(before.begin(), before.end(), actor) ==
+                     before.end();
+            }));
+}
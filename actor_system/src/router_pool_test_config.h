@@ -7,6 +7,9 @@
 
 #include <cdcf/actor_system.h>
 
+#include <chrono>
+#include <thread>
+
 using simple_calculator =
     caf::typed_actor<caf::replies_to<int, int>::with<caf::message>>;
 
@@ -31,11 +34,21 @@ simple_calculator::behavior_type simple_calculator_fun(
   }};
 }
 
+/* takes a while on each request, so requests pile up. */
+simple_calculator::behavior_type slow_calculator_fun(
+    simple_calculator::pointer self) {
+  return {[=](int a, int b) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return caf::make_message(a + b, self->id());
+  }};
+}
+
 class router_config : public cdcf::actor_system::Config {
  public:
   router_config() {
     load<caf::io::middleman>();
     add_actor_type("simple_calculator", simple_calculator_fun);
+    add_actor_type("slow_calculator", slow_calculator_fun);
   }
 };
 
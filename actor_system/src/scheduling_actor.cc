@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+#include "cdcf/scheduling_actor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cdcf {
+
+SchedulingActor::SchedulingActor(caf::actor_config& cfg, size_t batch)
+    : event_based_actor(cfg), batch_(std::max<size_t>(batch, 1)) {}
+
+void SchedulingActor::enqueue(caf::mailbox_element_ptr ptr,
+                              caf::execution_unit* eu) {
+  if (ptr->mid.is_response() ||
+      ptr->mid.category() != caf::message_id::normal_message_category) {
+    scheduled_actor::enqueue(std::move(ptr), eu);
+    return;
+  }
+  std::vector<Outgoing> outgoing;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      // let the mailbox bounce it
+      Post(nullptr, std::move(ptr));
+    } else {
+      Push(std::move(ptr), eu);
+      Release(eu);
+    }
+    outgoing.swap(outbox_);
+  }
+  Deliver(outgoing, eu);
+}
+
+caf::resumable::resume_result SchedulingActor::resume(
+    caf::execution_unit* eu, size_t max_throughput) {
+  auto result = scheduled_actor::resume(eu, max_throughput);
+  std::vector<Outgoing> outgoing;
+  if (result == resumable::awaiting_message) {
+    // mailbox is drained, so is everything released
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = 0;
+    Release(eu);
+    outgoing.swap(outbox_);
+  } else if (result == resumable::done) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    while (auto ptr = Pop(eu)) {
+      Post(nullptr, std::move(ptr));
+    }
+    outgoing.swap(outbox_);
+  }
+  Deliver(outgoing, eu);
+  return result;
+}
+
+void SchedulingActor::StripTag(caf::mailbox_element_ptr& ptr, size_t count) {
+  auto message = ptr->move_content_to_message().drop(count);
+  ptr = caf::make_mailbox_element(std::move(ptr->sender), ptr->mid,
+                                  std::move(ptr->stages), std::move(message));
+}
+
+void SchedulingActor::Release(caf::execution_unit* eu) {
+  while (released_ < batch_) {
+    auto next = Pop(eu);
+    if (!next) {
+      return;
+    }
+    ++released_;
+    Post(nullptr, std::move(next));
+  }
+}
+
+void SchedulingActor::Post(caf::strong_actor_ptr receiver,
+                           caf::mailbox_element_ptr mail) {
+  outbox_.push_back(Outgoing{std::move(receiver), std::move(mail)});
+}
+
+void SchedulingActor::Deliver(std::vector<Outgoing>& outgoing,
+                              caf::execution_unit* eu) {
+  for (auto& [receiver, mail] : outgoing) {
+    if (receiver) {
+      receiver->enqueue(std::move(mail), eu);
+    } else {
+      scheduled_actor::enqueue(std::move(mail), eu);
+    }
+  }
+}
+
+}  // namespace cdcf
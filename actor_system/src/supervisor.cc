@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#include "cdcf/supervisor.h"
+
+#include <cdcf/logger.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace cdcf {
+namespace {
+using started_atom = caf::atom_constant<caf::atom("started")>;
+}  // namespace
+
+Supervisor::Supervisor(caf::actor_config& cfg, SupervisorPolicy policy)
+    : ActorMonitor(cfg), policy_(std::move(policy)) {}
+
+caf::behavior Supervisor::make_behavior() {
+  caf::message_handler supervisor{
+      [=](supervise_atom, const ChildSpec& spec) {
+        children_.push_back(Child{spec, next_id_++});
+        auto promise = make_response_promise();
+        children_.back().promise = promise;
+        Start(children_.back());
+        return promise;
+      },
+      [=](started_atom, uint64_t id, uint64_t attempt, caf::actor& actor) {
+        Started(id, attempt, std::move(actor));
+      },
+      [=](caf::get_atom, const std::string& name) -> caf::actor {
+        auto it = Find(name);
+        return it == children_.end() ? caf::actor{} : it->actor;
+      },
+      [=](caf::delete_atom, const std::string& name) {
+        auto it = Find(name);
+        if (it == children_.end()) {
+          return;
+        }
+        if (it->actor) {
+          demonitor(it->actor);
+          Forget(it->actor.address());
+        }
+        children_.erase(it);
+      },
+      [=](restart_atom) {
+        restart_scheduled_ = false;
+        Restart();
+      }};
+  return supervisor.or_else(ActorMonitor::make_behavior());
+}
+
+void Supervisor::on_exit() {
+  // children still starting are stopped by their helpers
+  for (auto& child : children_) {
+    if (child.actor) {
+      caf::anon_send_exit(child.actor, caf::exit_reason::user_shutdown);
+    }
+  }
+  children_.clear();
+}
+
+void Supervisor::OnDown(const caf::down_msg& down_msg) {
+  ActorMonitor::OnDown(down_msg);
+  // a restarted child is described anew under its new address
+  Forget(down_msg.source);
+  auto it = Find(down_msg.source);
+  if (it == children_.end()) {
+    return;
+  }
+  if (!down_msg.reason) {
+    CDCF_LOGGER_INFO("child:{} exit normally, stop supervising it",
+                     it->spec.name);
+    children_.erase(it);
+    return;
+  }
+
+  CDCF_LOGGER_ERROR("child:{} down, reason:{}, restart it", it->spec.name,
+                    caf::to_string(down_msg.reason));
+  it->actor = nullptr;
+  auto failed = it - children_.begin();
+  switch (policy_.strategy) {
+    case RestartStrategy::one_for_one:
+      break;
+    case RestartStrategy::one_for_all:
+      std::for_each(children_.begin(), children_.end(),
+                    [this](Child& child) { Stop(child); });
+      break;
+    case RestartStrategy::rest_for_one:
+      std::for_each(children_.begin() + failed, children_.end(),
+                    [this](Child& child) { Stop(child); });
+      break;
+  }
+  ScheduleRestart();
+}
+
+std::vector<Supervisor::Child>::iterator Supervisor::Find(
+    const caf::actor_addr& actor) {
+  return std::find_if(children_.begin(), children_.end(), [&](Child& child) {
+    return child.actor && child.actor.address() == actor;
+  });
+}
+
+std::vector<Supervisor::Child>::iterator Supervisor::Find(
+    const std::string& name) {
+  return std::find_if(children_.begin(), children_.end(),
+                      [&](Child& child) { return child.spec.name == name; });
+}
+
+std::vector<Supervisor::Child>::iterator Supervisor::Find(uint64_t id) {
+  return std::find_if(children_.begin(), children_.end(),
+                      [&](Child& child) { return child.id == id; });
+}
+
+void Supervisor::Start(Child& child) {
+  child.starting = true;
+  ++child.attempt;
+  auto supervisor = caf::actor_cast<caf::actor>(this);
+  system().spawn<caf::detached>([supervisor, spawn = child.spec.spawn,
+                                 id = child.id, attempt = child.attempt](
+                                    caf::event_based_actor* self) {
+    auto actor = spawn ? spawn() : caf::actor{};
+    self->request(supervisor, caf::infinite, started_atom::value, id, attempt,
+                  actor)
+        .then([] {},
+              [actor](caf::error&) {
+                // supervisor is gone, nobody would stop the child
+                if (actor) {
+                  caf::anon_send_exit(actor, caf::exit_reason::user_shutdown);
+                }
+              });
+  });
+}
+
+void Supervisor::Started(uint64_t id, uint64_t attempt, caf::actor actor) {
+  auto it = Find(id);
+  if (it == children_.end() || !it->starting || it->attempt != attempt) {
+    // child is stopped or dropped meanwhile
+    if (actor) {
+      caf::anon_send_exit(actor, caf::exit_reason::user_shutdown);
+    }
+    return;
+  }
+  it->starting = false;
+  if (!actor) {
+    CDCF_LOGGER_ERROR("spawn child:{} failed", it->spec.name);
+    if (it->promise.pending()) {
+      it->promise.deliver(make_error(supervisor_error::spawn_failed));
+      children_.erase(it);
+      return;
+    }
+    ScheduleRestart();
+    return;
+  }
+  it->actor = std::move(actor);
+  monitor(it->actor);
+  Describe(it->actor.address(), it->spec.name);
+  if (it->promise.pending()) {
+    it->promise.deliver(it->actor);
+  }
+}
+
+void Supervisor::Stop(Child& child) {
+  // a start in flight is discarded once it ends
+  child.starting = false;
+  if (!child.actor) {
+    return;
+  }
+  // stopped on purpose, its down is not a failure
+  demonitor(child.actor);
+  Forget(child.actor.address());
+  send_exit(child.actor, caf::exit_reason::user_shutdown);
+  child.actor = nullptr;
+}
+
+void Supervisor::Restart() {
+  for (auto& child : children_) {
+    if (!child.actor && !child.starting) {
+      Start(child);
+    }
+  }
+}
+
+void Supervisor::ScheduleRestart() {
+  auto now = std::chrono::steady_clock::now();
+  while (!restarts_.empty() && now - restarts_.front() > policy_.period) {
+    restarts_.pop_front();
+  }
+  if (restarts_.size() >= policy_.max_restarts) {
+    CDCF_LOGGER_ERROR("restart more than {} times in {}ms, supervisor quits",
+                      policy_.max_restarts, policy_.period.count());
+    quit(make_error(supervisor_error::restart_intensity_reached));
+    return;
+  }
+  // every failure counts, also one a restart is already scheduled for
+  restarts_.push_back(now);
+  if (restart_scheduled_) {
+    return;
+  }
+  // shift is capped, max_backoff is reached long before
+  auto shift = std::min<size_t>(restarts_.size() - 1, 16);
+  auto backoff = std::min(policy_.backoff * (1 << shift), policy_.max_backoff);
+  restart_scheduled_ = true;
+  delayed_send(this, backoff, restart_atom::value);
+}
+
+caf::error make_error(supervisor_error x) {
+  return {static_cast<uint8_t>(x), caf::atom("supervisor")};
+}
+
+std::string to_string(supervisor_error x) {
+  switch (x) {
+    case supervisor_error::spawn_failed:
+      return "spawn failed";
+    case supervisor_error::restart_intensity_reached:
+      return "restart intensity reached";
+    default:
+      return "-unknown-error-";
+  }
+}
+
+}  // namespace cdcf
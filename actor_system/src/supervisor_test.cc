@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2020 ThoughtWorks Inc.
+ */
+
+#include "cdcf/supervisor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+caf::behavior supervised_worker(caf::event_based_actor* self) {
+  return {[=](int value) { return value; }};
+}
+
+class SupervisorTest : public ::testing::Test {
+ public:
+  cdcf::ChildSpec Spec(const std::string& name) {
+    auto spawns = spawns_;
+    return {name, [this, spawns] {
+              ++*spawns;
+              return system_.spawn(supervised_worker);
+            }};
+  }
+
+  caf::actor Supervise(const caf::actor& supervisor,
+                       const cdcf::ChildSpec& spec) {
+    caf::actor result;
+    self_->request(supervisor, caf::infinite, cdcf::supervise_atom::value, spec)
+        .receive([&](const caf::actor& child) { result = child; },
+                 [&](caf::error&) { ADD_FAILURE(); });
+    return result;
+  }
+
+  caf::actor Get(const caf::actor& supervisor, const std::string& name) {
+    caf::actor result;
+    self_->request(supervisor, caf::infinite, caf::get_atom::value, name)
+        .receive([&](const caf::actor& child) { result = child; },
+                 [&](caf::error&) { ADD_FAILURE(); });
+    return result;
+  }
+
+  /* current actor of a child once it's not `old` anymore. */
+  caf::actor Replaced(const caf::actor& supervisor, const std::string& name,
+                      const caf::actor& old) {
+    for (int i = 0; i < 100; ++i) {
+      auto actor = Get(supervisor, name);
+      if (actor && actor != old) {
+        return actor;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return {};
+  }
+
+  cdcf::SupervisorPolicy Policy(cdcf::RestartStrategy strategy) {
+    cdcf::SupervisorPolicy policy;
+    policy.strategy = strategy;
+    policy.backoff = std::chrono::milliseconds(10);
+    return policy;
+  }
+
+  std::shared_ptr<std::atomic<int>> spawns_ =
+      std::make_shared<std::atomic<int>>(0);
+  caf::actor_system_config config_;
+  caf::actor_system system_{config_};
+  caf::scoped_actor self_{system_};
+};
+
+TEST_F(SupervisorTest, should_restart_failed_child_only_for_one_for_one) {
+  auto supervisor = system_.spawn<cdcf::Supervisor>(
+      Policy(cdcf::RestartStrategy::one_for_one));
+  auto first = Supervise(supervisor, Spec("first"));
+  auto second = Supervise(supervisor, Spec("second"));
+
+  self_->send_exit(first, caf::exit_reason::kill);
+
+  auto restarted = Replaced(supervisor, "first", first);
+  ASSERT_TRUE(restarted);
+  EXPECT_EQ(second, Get(supervisor, "second"));
+  EXPECT_EQ(3, spawns_->load());
+  self_->request(restarted, caf::infinite, 1)
+      .receive([](int value) { EXPECT_EQ(1, value); },
+               [](caf::error&) { ADD_FAILURE(); });
+}
+
+TEST_F(SupervisorTest, should_restart_all_children_for_one_for_all) {
+  auto supervisor = system_.spawn<cdcf::Supervisor>(
+      Policy(cdcf::RestartStrategy::one_for_all));
+  auto first = Supervise(supervisor, Spec("first"));
+  auto second = Supervise(supervisor, Spec("second"));
+
+  self_->send_exit(second, caf::exit_reason::kill);
+
+  EXPECT_TRUE(Replaced(supervisor, "second", second));
+  EXPECT_TRUE(Replaced(supervisor, "first", first));
+  self_->wait_for(first);
+  EXPECT_EQ(4, spawns_->load());
+}
+
+TEST_F(SupervisorTest,
+       should_restart_failed_and_later_children_for_rest_for_one) {
+  auto supervisor = system_.spawn<cdcf::Supervisor>(
+      Policy(cdcf::RestartStrategy::rest_for_one));
+  auto first = Supervise(supervisor, Spec("first"));
+  auto second = Supervise(supervisor, Spec("second"));
+  auto third = Supervise(supervisor, Spec("third"));
+
+  self_->send_exit(second, caf::exit_reason::kill);
+
+  EXPECT_TRUE(Replaced(supervisor, "second", second));
+  EXPECT_TRUE(Replaced(supervisor, "third", third));
+  self_->wait_for(third);
+  EXPECT_EQ(first, Get(supervisor, "first"));
+  EXPECT_EQ(5, spawns_->load());
+}
+
+TEST_F(SupervisorTest, should_quit_when_restart_intensity_reached) {
+  auto policy = Policy(cdcf::RestartStrategy::rest_for_one);
+  policy.max_restarts = 1;
+  auto supervisor = system_.spawn<cdcf::Supervisor>(policy);
+  auto child = Supervise(supervisor, Spec("child"));
+
+  self_->send_exit(child, caf::exit_reason::kill);
+  child = Replaced(supervisor, "child", child);
+  ASSERT_TRUE(child);
+  self_->monitor(supervisor);
+  self_->send_exit(child, caf::exit_reason::kill);
+
+  caf::error reason;
+  self_->receive([&](const caf::down_msg& msg) { reason = msg.reason; });
+  EXPECT_EQ(
+      cdcf::make_error(cdcf::supervisor_error::restart_intensity_reached),
+      reason);
+}
+
+TEST_F(SupervisorTest, should_count_failures_while_restart_is_scheduled) {
+  auto policy = Policy(cdcf::RestartStrategy::one_for_one);
+  policy.max_restarts = 1;
+  policy.backoff = std::chrono::milliseconds(1000);
+  auto supervisor = system_.spawn<cdcf::Supervisor>(policy);
+  auto first = Supervise(supervisor, Spec("first"));
+  auto second = Supervise(supervisor, Spec("second"));
+  self_->monitor(supervisor);
+
+  self_->send_exit(first, caf::exit_reason::kill);
+  self_->send_exit(second, caf::exit_reason::kill);
+
+  caf::error reason;
+  self_->receive([&](const caf::down_msg& msg) { reason = msg.reason; });
+  EXPECT_EQ(
+      cdcf::make_error(cdcf::supervisor_error::restart_intensity_reached),
+      reason);
+}
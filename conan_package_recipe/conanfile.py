@@ -9,8 +9,8 @@ class CdcfConan(ConanFile):
     description = "HPC Internal Project"
     topics = ("actor model", "distributed computing framework", "caf")
     settings = "os", "compiler", "build_type", "arch"
-    options = {"shared": [True, False]}
-    default_options = {"shared": False}
+    options = {"shared": [True, False], "benchmark": [True, False]}
+    default_options = {"shared": False, "benchmark": False}
     generators = "cmake"
 
     def source(self):
@@ -32,6 +32,10 @@ class CdcfConan(ConanFile):
         self.requires("grpc/1.25.0@inexorgame/stable")
         self.requires("spdlog/1.4.2")
 
+    def build_requirements(self):
+        if self.options.benchmark:
+            self.build_requires("benchmark/1.5.0")
+
     def build(self):
         if self.settings.os == "Macos":
             self.run('mkdir unzipFolder')
@@ -28,7 +28,8 @@ void caf_main(caf::actor_system& system, const Config& config) {
       std::cerr << "Exception: " << e.what() << "\n";
     }
   } else {
-    InitWorker(system, actor_system_port);
+    caf::scoped_execution_unit context{&system};
+    auto router = InitWorker(system, &context, actor_system_port);
     while (true) {
       std::cin.get();
     }
@@ -15,6 +15,9 @@ struct WorkerStats {
   size_t count;
 };
 
+/* Balances between node routers, each of which balances between calculators
+ * of its own node, so server holds one entry per node instead of per worker.
+ * Node routers report their capacity after joining. */
 class WorkerRouter : public cdcf::cluster::Observer {
  public:
   WorkerRouter(caf::actor_system& system, const std::string host, uint16_t port)
@@ -27,10 +30,10 @@ class WorkerRouter : public cdcf::cluster::Observer {
   }
 
   void AddWorker(const cdcf::cluster::Member& member) {
-    caf::actor worker;
+    caf::actor node;
     for (;;) {
       try {
-        worker = SpawnWorkers(member);
+        node = ConnectNode(member);
         break;
       } catch (const std::exception& e) {
         std::cout << "exception: " << e.what() << std::endl;
@@ -38,11 +41,11 @@ class WorkerRouter : public cdcf::cluster::Observer {
       }
     }
 
-    caf::anon_send(balancer_, caf::sys_atom::value, caf::put_atom::value,
-                   worker);
+    caf::anon_send(node, caf::sys_atom::value, caf::join_atom::value,
+                   balancer_);
 
     members_.emplace_back(member);
-    workers_.emplace_back(worker);
+    nodes_.emplace_back(node);
   }
 
   void DeleteWorker(const cdcf::cluster::Member& member) {
@@ -53,11 +56,13 @@ class WorkerRouter : public cdcf::cluster::Observer {
       return;
     }
     auto index = it - members_.begin();
-    auto worker = workers_[index];
+    auto node = nodes_[index];
+    caf::anon_send(node, caf::sys_atom::value, caf::leave_atom::value,
+                   balancer_);
     caf::anon_send(balancer_, caf::sys_atom::value, caf::delete_atom::value,
-                   worker);
+                   node);
     members_.erase(it);
-    workers_.erase(workers_.begin() + index);
+    nodes_.erase(nodes_.begin() + index);
   }
 
   void Update(const cdcf::cluster::Event& event) override {
@@ -80,16 +85,21 @@ class WorkerRouter : public cdcf::cluster::Observer {
     std::vector<WorkerStats> result(members_.size());
     std::generate_n(result.begin(), members_.size(), [&, i = 0]() mutable {
       const auto& name = members_[i].name;
-      const auto message = make_function_view(workers_[i])(0);
+      const auto message = make_function_view(nodes_[i])(
+          caf::sys_atom::value, caf::get_atom::value);
       ++i;
-      return WorkerStats{name, message->get_as<size_t>(0)};
+      size_t count = 0;
+      for (const auto& worker : message->get_as<std::vector<caf::actor>>(0)) {
+        count += make_function_view(worker)(0)->get_as<size_t>(0);
+      }
+      return WorkerStats{name, count};
     });
     return result;
   }
 
  private:
   void InitLoadBalancer() {
-    auto policy = cdcf::load_balancer::policy::MinLoad();
+    auto policy = cdcf::load_balancer::policy::PowerOfTwoChoices();
     balancer_ = cdcf::load_balancer::Router::Make(&context_, std::move(policy));
     cdcf::cluster::Cluster::GetInstance()->AddObserver(this);
     std::lock_guard lock{mutex_};
@@ -109,25 +119,15 @@ class WorkerRouter : public cdcf::cluster::Observer {
     return members;
   }
 
-  caf::actor SpawnWorkers(const cdcf::cluster::Member& member) const {
-    std::cout << "routee: " << member.host << ":" << port_ << std::endl;
-    auto node = system_.middleman().connect(member.host, port_);
+  caf::actor ConnectNode(const cdcf::cluster::Member& member) const {
+    std::cout << "node router: " << member.host << ":" << port_ << std::endl;
+    auto node = system_.middleman().remote_actor(member.host, port_);
     if (!node) {
       std::cerr << "*** connect failed: " << system_.render(node.error())
                 << std::endl;
-      throw std::runtime_error("failed to connect cluster");
-    }
-    const auto type = "Calculator";
-    auto args = caf::make_message();
-    auto timeout = std::chrono::seconds(30);
-    auto worker = system_.middleman().remote_spawn<caf::actor>(*node, type,
-                                                               args, timeout);
-    if (!worker) {
-      std::cerr << "*** remote spawn failed: " << system_.render(worker.error())
-                << std::endl;
-      throw std::runtime_error("failed to spawn actor");
+      throw std::runtime_error("failed to connect node router");
     }
-    return *worker;
+    return *node;
   }
 
   caf::actor_system& system_;
@@ -136,7 +136,7 @@ class WorkerRouter : public cdcf::cluster::Observer {
   std::string host_;
   uint16_t port_;
   std::mutex mutex_;
-  std::vector<caf::actor> workers_;
+  std::vector<caf::actor> nodes_;
   caf::actor balancer_;
 };
 
@@ -5,6 +5,9 @@
 #define DEMOS_LOAD_BALANCER_WORKER_H_
 #include <cdcf/actor_system.h>
 
+#include <algorithm>
+#include <thread>
+
 caf::behavior CalculatorFun(caf::stateful_actor<size_t>* self) {
   return {
       [=](size_t x) {
@@ -19,13 +22,23 @@ caf::behavior CalculatorFun(caf::stateful_actor<size_t>* self) {
   };
 }
 
-void InitWorker(caf::actor_system& system, uint16_t port) {
+/* Each worker node fronts its calculators with a local router, server only
+ * balances between node routers. */
+caf::actor InitWorker(caf::actor_system& system, caf::execution_unit* context,
+                      uint16_t port) {
   std::cout << "actor system port: " << port << std::endl;
-  auto res = system.middleman().open(port);
+  auto router = cdcf::load_balancer::Router::Make(
+      context, cdcf::load_balancer::policy::MinLoad());
+  auto count = std::max(std::thread::hardware_concurrency(), 1u);
+  for (size_t i = 0; i < count; ++i) {
+    caf::anon_send(router, caf::sys_atom::value, caf::put_atom::value,
+                   system.spawn(CalculatorFun));
+  }
+  auto res = system.middleman().publish(router, port);
   if (!res) {
-    std::cerr << "*** cannot open port: " << system.render(res.error())
-              << std::endl;
-    return;
+    std::cerr << "*** cannot publish node router: "
+              << system.render(res.error()) << std::endl;
   }
+  return router;
 }
 #endif  // DEMOS_LOAD_BALANCER_WORKER_H_
@@ -18,21 +18,58 @@ caf::behavior CdcfSpawn::make_behavior() {
       [&](caf::spawn_atom, std::string& actor_type, caf::message& actor_args,
           const caf::actor_system::mpi& actor_ifs, std::string& reg_name,
           std::string& reg_description) -> caf::actor {
-        if (auto res = system().spawn<caf::actor>(actor_type, actor_args,
-                                                  nullptr, true, &actor_ifs)) {
-          if (monitor_ != nullptr) {
-            monitor_->RegisterActor(*res, reg_name, reg_description);
-          }
-          return *res;
-        }
-        return nullptr;
+        return Spawn(actor_type, actor_args, actor_ifs, &reg_name,
+                     &reg_description);
       },
       [&](caf::spawn_atom, std::string& actor_type, caf::message& actor_args,
           const caf::actor_system::mpi& actor_ifs) -> caf::actor {
-        if (auto res = system().spawn<caf::actor>(actor_type, actor_args,
-                                                  nullptr, true, &actor_ifs)) {
-          return *res;
-        }
-        return nullptr;
+        return Spawn(actor_type, actor_args, actor_ifs, nullptr, nullptr);
+      },
+      [&](caf::spawn_atom, size_t count, std::string& actor_type,
+          caf::message& actor_args, const caf::actor_system::mpi& actor_ifs,
+          std::string& reg_name,
+          std::string& reg_description) -> std::vector<caf::actor> {
+        return SpawnMany(count, actor_type, actor_args, actor_ifs, &reg_name,
+                         &reg_description);
+      },
+      [&](caf::spawn_atom, size_t count, std::string& actor_type,
+          caf::message& actor_args, const caf::actor_system::mpi& actor_ifs)
+          -> std::vector<caf::actor> {
+        return SpawnMany(count, actor_type, actor_args, actor_ifs, nullptr,
+                         nullptr);
       }};
 }
+
+caf::actor CdcfSpawn::Spawn(const std::string& actor_type,
+                            const caf::message& actor_args,
+                            const caf::actor_system::mpi& actor_ifs,
+                            const std::string* reg_name,
+                            const std::string* reg_description) {
+  auto res = system().spawn<caf::actor>(actor_type, actor_args, nullptr, true,
+                                        &actor_ifs);
+  if (!res) {
+    return nullptr;
+  }
+  if (monitor_ != nullptr && reg_name != nullptr) {
+    monitor_->RegisterActor(*res, *reg_name, *reg_description);
+  }
+  return *res;
+}
+
+std::vector<caf::actor> CdcfSpawn::SpawnMany(
+    size_t count, const std::string& actor_type, const caf::message& actor_args,
+    const caf::actor_system::mpi& actor_ifs, const std::string* reg_name,
+    const std::string* reg_description) {
+  std::vector<caf::actor> result;
+  result.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto actor =
+        Spawn(actor_type, actor_args, actor_ifs, reg_name, reg_description);
+    if (actor == nullptr) {
+      // stop at the first failure, caller sees how many were spawned
+      break;
+    }
+    result.push_back(std::move(actor));
+  }
+  return result;
+}
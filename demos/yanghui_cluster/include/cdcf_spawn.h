@@ -5,6 +5,9 @@
 #ifndef DEMOS_YANGHUI_CLUSTER_INCLUDE_CDCF_SPAWN_H_
 #define DEMOS_YANGHUI_CLUSTER_INCLUDE_CDCF_SPAWN_H_
 
+#include <string>
+#include <vector>
+
 #include "cdcf/actor_status_monitor.h"
 
 class CdcfSpawn : public caf::event_based_actor {
@@ -15,6 +18,19 @@ class CdcfSpawn : public caf::event_based_actor {
   caf::behavior make_behavior() override;
 
  private:
+  /* register to monitor only if `reg_name` is given. */
+  caf::actor Spawn(const std::string& actor_type,
+                   const caf::message& actor_args,
+                   const caf::actor_system::mpi& actor_ifs,
+                   const std::string* reg_name,
+                   const std::string* reg_description);
+  /* spawn up to `count` actors in one request, stop at the first failure. */
+  std::vector<caf::actor> SpawnMany(size_t count, const std::string& actor_type,
+                                    const caf::message& actor_args,
+                                    const caf::actor_system::mpi& actor_ifs,
+                                    const std::string* reg_name,
+                                    const std::string* reg_description);
+
   cdcf::ActorStatusMonitor* monitor_;
 };
 